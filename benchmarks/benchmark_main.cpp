@@ -0,0 +1,16 @@
+#include "benchmarks.hpp"
+
+// std
+#include <cstdlib>
+#include <thread>
+
+// usage: benchmarks [maxThreads], defaults to every hardware thread
+int main(int argc, char **argv)
+{
+	uint32_t maxThreads = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : std::thread::hardware_concurrency();
+	if (maxThreads == 0) maxThreads = 1;
+
+	lve::bench::jobSystemScaling(maxThreads);
+	lve::bench::mpscQueueContention(maxThreads);
+	return 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+namespace lve::bench {
+	// best of a few runs in milliseconds, the first run warms caches and thread pools
+	inline double bestOf(uint32_t runs, const std::function<void()> &fn)
+	{
+		fn();
+
+		double best = std::numeric_limits<double>::max();
+		for (uint32_t i = 0; i < runs; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+
+	// parallelFor over a transform style workload with 1 to maxThreads threads
+	void jobSystemScaling(uint32_t maxThreads);
+	// push throughput with 1 to maxThreads - 1 producers against one consumer draining at the same time
+	void mpscQueueContention(uint32_t maxThreads);
+} // namespace lve::bench
@@ -0,0 +1,51 @@
+#include "benchmarks.hpp"
+#include "lve_job_system.hpp"
+
+// std
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace lve::bench {
+	static constexpr uint32_t ELEMENT_COUNT = 1u << 20;
+	static constexpr uint32_t GRAIN_SIZE = 4096;
+	static constexpr uint32_t RUNS = 5;
+
+	// a few dozen flops per element, about what a transform update costs
+	static void work(std::vector<float> &values, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			float x = values[i];
+			for (int k = 0; k < 8; k++)
+				x = std::sin(x) * 0.5f + std::cos(x * 1.5f);
+			values[i] = x;
+		}
+	}
+
+	void jobSystemScaling(uint32_t maxThreads)
+	{
+		std::vector<float> values(ELEMENT_COUNT);
+		for (uint32_t i = 0; i < ELEMENT_COUNT; i++)
+			values[i] = static_cast<float>(i) * 0.001f;
+
+		std::printf("job system parallelFor, %u elements, grain %u\n", ELEMENT_COUNT, GRAIN_SIZE);
+		std::printf("%8s %10s %8s %10s\n", "threads", "ms", "speedup", "efficiency");
+
+		// one thread is the plain loop, a job system always has at least one worker
+		double serial = bestOf(RUNS, [&]() { work(values, 0, ELEMENT_COUNT); });
+		std::printf("%8u %10.2f %8.2f %9.0f%%\n", 1u, serial, 1.0, 100.0);
+
+		for (uint32_t threads = 2; threads <= maxThreads; threads++)
+		{
+			LveJobSystem jobSystem{threads - 1};
+			double ms = bestOf(RUNS, [&]() {
+				jobSystem.parallelFor(ELEMENT_COUNT, GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+					work(values, begin, end);
+				});
+			});
+			double speedup = serial / ms;
+			std::printf("%8u %10.2f %8.2f %9.0f%%\n", threads, ms, speedup, speedup / threads * 100.0);
+		}
+	}
+} // namespace lve::bench
@@ -0,0 +1,61 @@
+#include "benchmarks.hpp"
+#include "lve_mpsc_queue.hpp"
+
+// std
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace lve::bench {
+	static constexpr uint32_t PUSHES_PER_PRODUCER = 1u << 20;
+
+	// about the size of a scene command
+	struct Command {
+		uint64_t id = 0;
+		float payload[6]{};
+	};
+
+	void mpscQueueContention(uint32_t maxThreads)
+	{
+		std::printf("mpsc queue, %u pushes per producer, one draining consumer\n", PUSHES_PER_PRODUCER);
+		std::printf("%10s %10s %12s\n", "producers", "ms", "Mops/s");
+
+		// the consumer takes one thread, at least one producer runs even on a single core
+		uint32_t maxProducers = maxThreads > 1 ? maxThreads - 1 : 1;
+		for (uint32_t producers = 1; producers <= maxProducers; producers++)
+		{
+			uint64_t total = uint64_t{producers} * PUSHES_PER_PRODUCER;
+			uint64_t consumed = 0;
+
+			double ms = bestOf(3, [&]() {
+				LveMpscQueue<Command> queue;
+				std::atomic<bool> start{false};
+				std::vector<std::thread> threads;
+				for (uint32_t p = 0; p < producers; p++)
+				{
+					threads.emplace_back([&, p]() {
+						while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+						for (uint32_t i = 0; i < PUSHES_PER_PRODUCER; i++)
+							queue.push(Command{uint64_t{p} << 32 | i});
+					});
+				}
+
+				start.store(true, std::memory_order_release);
+				consumed = 0;
+				while (consumed < total)
+				{
+					if (queue.drain([&](Command &) { consumed++; }) == 0)
+						std::this_thread::yield();
+				}
+
+				for (auto &thread: threads)
+					thread.join();
+			});
+
+			if (consumed != total)
+				std::printf("lost %llu commands!\n", static_cast<unsigned long long>(total - consumed));
+			std::printf("%10u %10.2f %12.2f\n", producers, ms, static_cast<double>(total) / ms / 1000.0);
+		}
+	}
+} // namespace lve::bench
@@ -9,6 +9,9 @@ layout(location = 4) in flat uint materialID;
 
 layout (location = 0) out vec4 outColor;
 
+// lights in the light buffer, set per pipeline
+layout(constant_id = 0) const int LIGHT_COUNT = 1;
+
 struct PointLight {
     mat4 proj;
     vec3 position;
@@ -34,10 +37,20 @@ layout(std430, set = 0, binding = 2) readonly buffer PointLightBuffer {
     PointLight light[];
 } pointLight;
 
+struct Material {
+    vec4 baseColor;
+    int albedoTexture;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
 layout(set = 0, binding = 3) uniform sampler2D textures[];
 layout(set = 0, binding = 4) uniform sampler2D shadowMap;
 
-//nonuniformEXT uint idx = materialID;
+layout(std430, set = 0, binding = 8) readonly buffer MaterialTable {
+    Material materials[];
+} materialTable;
 
 vec3 spotLight(int l)
 {
@@ -48,6 +61,17 @@ vec3 spotLight(int l)
 
 void main()
 {
+    // instances of one draw can use different materials, so the texture index is nonuniform
+    Material material = materialTable.materials[materialID];
+    vec4 albedo = material.baseColor;
+#ifdef TEXTURED
+    // only materials with a texture are drawn by this variant
+    albedo *= texture(textures[nonuniformEXT(material.albedoTexture)], UV);
+#endif
+
+    vec3 light = vec3(0.0);
+    for (int l = 0; l < LIGHT_COUNT; l++)
+        light += spotLight(l);
 
-    outColor = vec4(spotLight(0), 1);
+    outColor = vec4(light * albedo.rgb, albedo.a);
 }
\ No newline at end of file
@@ -13,12 +13,9 @@ layout(location = 2) out vec3 FragPos;
 layout(location = 3) out vec2 UV;
 layout(location = 4) out flat uint materialID;
 
+// top three rows of the affine model matrix, the last row is always (0,0,0,1)
 struct Object {
-    mat4 model;
-    uint materialId;
-    uint _pad0;
-    uint _pad1;
-    uint _pad2;
+    vec4 rows[3];
 };
 
 layout(set = 0, binding = 0, std140) uniform GlobalUbo {
@@ -34,17 +31,39 @@ layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
     Object objects[];
 } aa;
 
+// instances that never move, draws into them have STATIC_INSTANCE set on their first instance
+layout(std430, set = 0, binding = 6) readonly buffer StaticObjectBuffer {
+    Object objects[];
+} staticObjects;
+
+const uint STATIC_INSTANCE = 1u << 30;
+
+layout(std430, set = 0, binding = 5) readonly buffer MaterialBuffer {
+    uint materialIds[];
+} materials;
+
+layout(std430, set = 0, binding = 7) readonly buffer StaticMaterialBuffer {
+    uint materialIds[];
+} staticMaterials;
+
 
 
 void main() {
     uint objectID = gl_BaseInstance + gl_InstanceIndex;
 
-    gl_Position = ubo.projView * aa.objects[gl_InstanceIndex].model * vec4(position, 1.0);
+    uint instance = uint(gl_InstanceIndex);
+    bool isStatic = (instance & STATIC_INSTANCE) != 0u;
+    uint index = instance & ~STATIC_INSTANCE;
+    Object object = isStatic ? staticObjects.objects[index] : aa.objects[index];
+    // row vector times mat3x4 built from the rows gives the affine transform
+    vec3 worldPos = vec4(position, 1.0) * mat3x4(object.rows[0], object.rows[1], object.rows[2]);
+
+    gl_Position = ubo.projView * vec4(worldPos, 1.0);
 
-    FragPos = vec3(aa.objects[gl_InstanceIndex].model * vec4(position, 1.0));
+    FragPos = worldPos;
 
     Anormal = normal;
     fragColor = color;
     UV = uv;
-    materialID = aa.objects[gl_InstanceIndex].materialId;
+    materialID = isStatic ? staticMaterials.materialIds[index] : materials.materialIds[index];
 }
@@ -4,12 +4,9 @@
 
 layout(location = 0) in vec3 position;
 
+// top three rows of the affine model matrix, the last row is always (0,0,0,1)
 struct Object {
-    mat4 model;
-    uint materialId;
-    uint _pad0;
-    uint _pad1;
-    uint _pad2;
+    vec4 rows[3];
 };
 
 struct PointLight {
@@ -32,6 +29,18 @@ layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
     Object objects[];
 } aa;
 
+// instances that never move, draws into them have STATIC_INSTANCE set on their first instance
+layout(std430, set = 0, binding = 6) readonly buffer StaticObjectBuffer {
+    Object objects[];
+} staticObjects;
+
+const uint STATIC_INSTANCE = 1u << 30;
+
 void main() {
-    gl_Position = pointLight.light[0].proj * aa.objects[gl_InstanceIndex].model * vec4(position, 1.0);
+    uint instance = uint(gl_InstanceIndex);
+    bool isStatic = (instance & STATIC_INSTANCE) != 0u;
+    uint index = instance & ~STATIC_INSTANCE;
+    Object object = isStatic ? staticObjects.objects[index] : aa.objects[index];
+    vec3 worldPos = vec4(position, 1.0) * mat3x4(object.rows[0], object.rows[1], object.rows[2]);
+    gl_Position = pointLight.light[0].proj * vec4(worldPos, 1.0);
 }
@@ -1,5 +1,6 @@
 #include "Mesh.h"
 
+#include "lve_upload_manager.hpp"
 #include "lve_utils.hpp"
 
 // libs
@@ -15,8 +16,8 @@
 #include <iostream>
 #include <unordered_map>
 
-RenderBucket::RenderBucket(lve::LveDevice &device, uint32_t MAX_DRAW, lve::LveBuffer& objectSSBO) :
-	lveDevice(device), objectSSBO(objectSSBO), MAX_DRAW(MAX_DRAW)
+RenderBucket::RenderBucket(lve::LveDevice &device, uint32_t MAX_DRAW) :
+	lveDevice(device), MAX_DRAW(MAX_DRAW)
 {
 	// create draw buffer
 	uint32_t commandSize = sizeof(VkDrawIndexedIndirectCommand);
@@ -33,172 +34,443 @@ RenderBucket::RenderBucket(lve::LveDevice &device, uint32_t MAX_DRAW, lve::LveBu
 	);
 }
 
-void RenderBucket::createMeshes(const std::vector<std::string> &files)
+void RenderBucket::createMeshes(const std::vector<std::string> &files, lve::LveJobSystem *jobSystem)
 {
-	drawCommands.clear();
+	drawCount = 0;
 	vertices.clear();
 	indices.clear();
 	builder.clear();
 
-	uint32_t indexCount = 0;
-	OBJECT_TYPES = 0;
-
-	for (std::string const file: files)
-	{
-		Builder b;
-		b.loadModel(file);
-		b.id = indexCount;
+	// parsing is independent per file, only the concatenation below has to be ordered
+	builder.resize(files.size());
+	auto loadRange = [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++)
+		{
+			builder[i].loadModel(files[i]);
+			builder[i].id = i;
+		}
+	};
 
-		for (auto i: b.vertices) vertices.push_back(i);
+	if (jobSystem)
+		jobSystem->parallelFor(static_cast<uint32_t>(files.size()), 1, loadRange);
+	else
+		loadRange(0, static_cast<uint32_t>(files.size()));
 
-		for (auto i: b.indices) indices.push_back(i);
-		OBJECT_TYPES++;
-		builder.push_back(b);
-		indexCount++;
+	OBJECT_TYPES = static_cast<uint32_t>(builder.size());
+	staticVersion.fetch_add(1, std::memory_order_relaxed); // mesh ranges may have moved
+	meshRanges.clear();
+	for (const Builder &b: builder)
+	{
+		meshRanges.push_back({
+			static_cast<uint32_t>(indices.size()),
+			static_cast<uint32_t>(b.indices.size()),
+			static_cast<int32_t>(vertices.size())
+		});
+		vertices.insert(vertices.end(), b.vertices.begin(), b.vertices.end());
+		indices.insert(indices.end(), b.indices.begin(), b.indices.end());
 	}
 
 	createVertexBuffers(vertices);
 	createIndexBuffers(indices);
+}
 
-	stagingBuffer = std::make_unique<lve::LveBuffer>(
-	lveDevice,
-	sizeof(VkDrawIndexedIndirectCommand) * OBJECT_TYPES,
-	1,
-	VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-);
-	stagingBuffer->map();
+void RenderBucket::render(VkCommandBuffer commandBuffer, const std::function<void(uint32_t variant)>& bindVariant)
+{
+	VkBuffer vertexBuffers[] = {vertexBuffer->getBuffer()};
+	VkDeviceSize offsets[] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+	drawRuns(commandBuffer, bindVariant, 0, opaqueRunCount, 0, opaqueDrawCount);
 }
 
-void RenderBucket::render(VkCommandBuffer commandBuffer)
+void RenderBucket::renderTransparent(VkCommandBuffer commandBuffer,
+									const std::function<void(uint32_t variant)>& bindVariant)
 {
+	if (drawCount == opaqueDrawCount) return;
+
 	VkBuffer vertexBuffers[] = {vertexBuffer->getBuffer()};
 	VkDeviceSize offsets[] = {0};
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 	vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
-	vkCmdDrawIndexedIndirect(
-		commandBuffer,
-		drawCommandsBuffer->getBuffer(),
-		0,
-		static_cast<uint32_t>(drawCommands.size()),
-		sizeof(VkDrawIndexedIndirectCommand));
+	drawRuns(commandBuffer, bindVariant, opaqueRunCount, static_cast<uint32_t>(runs.size()) - opaqueRunCount,
+			opaqueDrawCount, drawCount - opaqueDrawCount);
+}
+
+void RenderBucket::drawRuns(VkCommandBuffer commandBuffer, const std::function<void(uint32_t variant)>& bindVariant,
+							uint32_t firstRun, uint32_t runCount, uint32_t firstDraw, uint32_t drawCount)
+{
+	constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (!bindVariant)
+	{
+		vkCmdDrawIndexedIndirect(commandBuffer, drawCommandsBuffer->getBuffer(), firstDraw * stride, drawCount, stride);
+		return;
+	}
+
+	for (uint32_t i = firstRun; i < firstRun + runCount; i++)
+	{
+		const DrawRun& run = runs[i];
+		bindVariant(run.variant);
+		vkCmdDrawIndexedIndirect(
+			commandBuffer,
+			drawCommandsBuffer->getBuffer(),
+			run.firstDraw * stride,
+			run.drawCount,
+			stride);
+	}
+}
+
+void RenderBucket::appendRun(std::vector<DrawRun>& runs, size_t firstRun, uint32_t variant, uint32_t drawIndex)
+{
+	if (runs.size() > firstRun && runs.back().variant == variant &&
+		runs.back().firstDraw + runs.back().drawCount == drawIndex)
+		runs.back().drawCount++;
+	else
+		runs.push_back({variant, drawIndex, 1});
+}
+
+void RenderBucket::setMaterialVariant(uint32_t materialId, uint32_t variant)
+{
+	assert(variant <= lve::RenderKey::mask(lve::RenderKey::PIPELINE_BITS) && "variant does not fit the render key");
+
+	if (materialId >= materialVariants.size())
+		materialVariants.resize(materialId + 1, 0);
+	materialVariants[materialId] = static_cast<uint8_t>(variant);
+	staticVersion.fetch_add(1, std::memory_order_relaxed); // the static draws have to be split again
 }
 
-void RenderBucket::update(double deltaTime, lve::LveBuffer& objectSSBOA)
+void RenderBucket::update(double deltaTime, const glm::vec3& cameraPosition, const BucketBuffers& buffers)
 {
-	// stuff
-	uint32_t firstIndex = 0;
-	int32_t vertexOffset = 0;
-	uint32_t runningBaseInstance = 0;
-	drawCommands.clear();
-	drawCommands.reserve(OBJECT_TYPES);
-	sortedBucket.clear();
-	sortedBucket.reserve(bucket.size());
+	buildFrame(frame, cameraPosition);
+	uploadFrame(frame, buffers);
+}
+
+void RenderBucket::buildQueue(const InstanceMap& partition, const glm::vec3* cameraPosition, float maxDistance,
+							uint32_t instanceFlags, BucketFrame& scratch, std::vector<Object>& objects,
+							std::vector<uint32_t>& materialIds,
+							std::vector<VkDrawIndexedIndirectCommand>& drawCommands,
+							std::vector<DrawRun>& runs) const
+{
+	auto& queue = scratch.queue;
+	queue.clear();
+	queue.reserve(partition.size());
+
+	partition.forEach([&](uint32_t index, const Instance& instance) {
+		if (instance.meshId >= OBJECT_TYPES) return; // no mesh to draw
+		if (instance.transparent) return; // goes through buildTransparent
+
+		// front to back, so early z can reject what is hidden behind closer instances
+		uint32_t depth = 0;
+		if (cameraPosition)
+		{
+			glm::vec3 position{instance.object.rows[0].w, instance.object.rows[1].w, instance.object.rows[2].w};
+			depth = lve::RenderKey::quantizeDepth(glm::distance(position, *cameraPosition), maxDistance);
+		}
+
+		uint64_t key = lve::RenderKey::make(lve::RenderKey::PASS_OPAQUE, variantOf(instance.materialId), instance.meshId,
+											instance.materialId, depth);
+		queue.push_back({key, index});
+	});
+
+	lve::radixSort(queue, scratch.queueScratch);
+
+	objects.resize(queue.size());
+	materialIds.resize(queue.size());
+	auto hot = partition.hotData();
+	for (uint32_t i = 0; i < queue.size(); i++)
+	{
+		const Instance& instance = hot[queue[i].index];
+		objects[i] = instance.object;
+		materialIds[i] = instance.materialId;
+
+		// a new draw only when pass, pipeline or mesh change, material and depth ride along in the instance data
+		if (i == 0 || lve::RenderKey::stateBits(queue[i].key) != lve::RenderKey::stateBits(queue[i - 1].key))
+		{
+			const MeshRange& mesh = meshRanges[lve::RenderKey::mesh(queue[i].key)];
+			appendRun(runs, 0, lve::RenderKey::pipeline(queue[i].key), static_cast<uint32_t>(drawCommands.size()));
+			drawCommands.push_back({mesh.indexCount, 0, mesh.firstIndex, mesh.vertexOffset, instanceFlags | i});
+		}
+		drawCommands.back().instanceCount++;
+	}
+}
 
-	for (uint32_t i = 0; i < OBJECT_TYPES; i++)
-		objectTypeIndex[i] = 0;
+void RenderBucket::buildFrame(BucketFrame& out, const glm::vec3& cameraPosition, float maxDistance) const
+{
+	out.instanceCapacity = instances.capacity();
+	out.staticCapacity = staticInstances.capacity();
 
-	for (uint32_t i = 0; i < bucket.size(); i++)
+	// the static partition is only walked again when something in it changed, so it goes without depth
+	uint32_t version = staticVersion.load(std::memory_order_acquire);
+	if (out.staticVersion != version)
 	{
-		if (!deadList[i]) continue;
-		objectTypeIndex[bucket[i].materialId]++;
-		sortedBucket.push_back(bucket[i]);
+		out.staticDrawCommands.clear();
+		out.staticRuns.clear();
+		buildQueue(staticInstances, nullptr, maxDistance, STATIC_INSTANCE, out,
+					out.staticObjects, out.staticMaterialIds, out.staticDrawCommands, out.staticRuns);
+		out.staticVersion = version;
 	}
 
-	std::sort(sortedBucket.begin(), sortedBucket.end(),
-		[](const Object& a, const Object& b){ return a.materialId < b.materialId; });
+	out.drawCommands.assign(out.staticDrawCommands.begin(), out.staticDrawCommands.end());
+	out.runs.assign(out.staticRuns.begin(), out.staticRuns.end());
+	buildQueue(instances, &cameraPosition, maxDistance, 0, out, out.objects, out.materialIds, out.drawCommands,
+				out.runs);
+	out.opaqueDrawCount = static_cast<uint32_t>(out.drawCommands.size());
+	out.opaqueRunCount = static_cast<uint32_t>(out.runs.size());
+
+	buildTransparent(out, cameraPosition);
+}
+
+void RenderBucket::buildTransparent(BucketFrame& out, const glm::vec3& cameraPosition) const
+{
+	auto distanceTo = [&](const Instance& instance) {
+		glm::vec3 position{instance.object.rows[0].w, instance.object.rows[1].w, instance.object.rows[2].w};
+		return glm::distance(position, cameraPosition);
+	};
+
+	// keep last order, dropping whatever died or stopped being transparent
+	auto& order = out.transparentOrder;
+	auto& seen = out.transparentSeen;
+	seen.assign(instances.capacity(), 0);
+
+	size_t kept = 0;
+	for (const TransparentEntry& entry: order)
+	{
+		const Instance* instance = instances.get(entry.handle);
+		if (!instance || !instance->transparent || instance->meshId >= OBJECT_TYPES) continue;
+
+		seen[instances.denseIndex(entry.handle)] = 1;
+		order[kept++] = TransparentEntry{entry.handle, distanceTo(*instance)};
+	}
+	order.resize(kept);
+
+	// insertion sort of the carried over part, far to near. with a coherent camera only a few entries move,
+	// so this stays close to O(n)
+	for (size_t i = 1; i < kept; i++)
+	{
+		TransparentEntry entry = order[i];
+		size_t j = i;
+		while (j > 0 && order[j - 1].depth < entry.depth)
+		{
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = entry;
+	}
 
-	for (int i = 0; i < OBJECT_TYPES; i++)
+	// new arrivals have no order to carry over, a bulk spawn would make the insertion sort quadratic.
+	// they are sorted on their own and merged in
+	auto fartherFirst = [](const TransparentEntry& a, const TransparentEntry& b) { return a.depth > b.depth; };
+	instances.forEach([&](uint32_t index, const Instance& instance) {
+		if (!instance.transparent || seen[index] || instance.meshId >= OBJECT_TYPES) return;
+		order.push_back(TransparentEntry{instances.handleAt(index), distanceTo(instance)});
+	});
+	if (order.size() > kept)
 	{
-		uint32_t instancesForThisMaterial = objectTypeIndex[i];
-
-		VkDrawIndexedIndirectCommand cmd{
-			static_cast<uint32_t>(builder[i].indices.size()),   // indexCount
-			instancesForThisMaterial,                  // instanceCount
-			firstIndex,                                // firstIndex
-			vertexOffset,                              // vertexOffset
-			runningBaseInstance                         // firstInstance
-		};
-		drawCommands.push_back(cmd);
-
-		// offsets
-		firstIndex += static_cast<uint32_t>(builder[i].indices.size());
-		vertexOffset += static_cast<int32_t>(builder[i].vertices.size());
-		runningBaseInstance += instancesForThisMaterial;
+		std::sort(order.begin() + kept, order.end(), fartherFirst);
+		std::inplace_merge(order.begin(), order.begin() + kept, order.end(), fartherFirst);
 	}
 
-	updateSSBO(objectSSBOA);
-    createDrawCommand();
+	// blending needs the exact order, so only neighbours with the same mesh and variant can share a draw
+	uint32_t lastMesh = ~0u, lastVariant = ~0u;
+	for (const TransparentEntry& entry: order)
+	{
+		const Instance& instance = *instances.get(entry.handle);
+		uint32_t firstInstance = static_cast<uint32_t>(out.objects.size());
+		out.objects.push_back(instance.object);
+		out.materialIds.push_back(instance.materialId);
+
+		uint32_t variant = variantOf(instance.materialId);
+		if (instance.meshId != lastMesh || variant != lastVariant)
+		{
+			const MeshRange& mesh = meshRanges[instance.meshId];
+			appendRun(out.runs, out.opaqueRunCount, variant, static_cast<uint32_t>(out.drawCommands.size()));
+			out.drawCommands.push_back({mesh.indexCount, 0, mesh.firstIndex, mesh.vertexOffset, firstInstance});
+			lastMesh = instance.meshId;
+			lastVariant = variant;
+		}
+		out.drawCommands.back().instanceCount++;
+	}
 }
 
-void RenderBucket::updateSSBO(lve::LveBuffer& objectSSBOA)
+void RenderBucket::uploadFrame(const BucketFrame& in, const BucketBuffers& buffers)
 {
+	updateSSBO(in, buffers);
+	if (in.staticVersion != uploadedStaticVersion)
+	{
+		uploadStatic(in, buffers);
+		uploadedStaticVersion = in.staticVersion;
+	}
+	createDrawCommand(in);
+}
 
-	if (bucket.empty()) return;
+void RenderBucket::updateSSBO(const BucketFrame& in, const BucketBuffers& buffers)
+{
+	if (in.objects.empty()) return;
+	lve::LveBuffer& objectSSBOA = *buffers.objects;
+	lve::LveBuffer& materialSSBO = *buffers.materials;
 	if (objectSSBOA.getMappedMemory() == nullptr)
 	{
 		objectSSBOA.map();
 	}
+	if (materialSSBO.getMappedMemory() == nullptr)
+	{
+		materialSSBO.map();
+	}
 
-	objectSSBOA.writeToBuffer(sortedBucket.data(), VK_WHOLE_SIZE);
+	// the draws index every instance, so the owner has to grow the buffers first. the clamp only keeps
+	// a missed grow from writing past the mapping
+	assert(objectSSBOA.getBufferSize() >= in.objects.size() * sizeof(Object) && "dynamic instance buffer too small");
+	assert(materialSSBO.getBufferSize() >= in.materialIds.size() * sizeof(uint32_t) && "material id buffer too small");
+	VkDeviceSize size = std::min<VkDeviceSize>(in.objects.size() * sizeof(Object), objectSSBOA.getBufferSize());
+	objectSSBOA.writeToBuffer((void *) in.objects.data(), size);
 	objectSSBOA.flush(VK_WHOLE_SIZE);
 
+	size = std::min<VkDeviceSize>(in.materialIds.size() * sizeof(uint32_t), materialSSBO.getBufferSize());
+	materialSSBO.writeToBuffer((void *) in.materialIds.data(), size);
+	materialSSBO.flush(VK_WHOLE_SIZE);
+}
 
-	for (size_t i = 0; i < bucket.size(); i++) {
-		//if (bucket[i].dirty)
-		//{
-		//objectSSBOA.writeToIndex(&bucket[i], i);
-		//objectSSBOA.flush(alignedSize, i * alignedSize);
-		//	bucket[i].dirty = false;
-		//}
-	}
+void RenderBucket::uploadStatic(const BucketFrame& in, const BucketBuffers& buffers)
+{
+	// the upload batch waits for the frame in flight that may still read the static buffers
+	auto upload = [&](const void* data, VkDeviceSize size, lve::LveBuffer& target) {
+		assert(target.getBufferSize() >= size && "static instance buffer too small");
+		size = std::min<VkDeviceSize>(size, target.getBufferSize());
+		lveDevice.uploads().uploadBuffer(target.getBuffer(), data, size);
+	};
 
+	upload(in.staticObjects.data(), in.staticObjects.size() * sizeof(Object), *buffers.staticObjects);
+	upload(in.staticMaterialIds.data(), in.staticMaterialIds.size() * sizeof(uint32_t), *buffers.staticMaterials);
 }
  //
-void RenderBucket::createDrawCommand()
+void RenderBucket::createDrawCommand(const BucketFrame& in)
 {
-	VkDeviceSize bufferSize = 1 * sizeof(VkDrawIndexedIndirectCommand);
+	drawCount = static_cast<uint32_t>(in.drawCommands.size());
+	opaqueDrawCount = in.opaqueDrawCount;
+	runs.assign(in.runs.begin(), in.runs.end());
+	opaqueRunCount = in.opaqueRunCount;
+	if (drawCount == 0) return;
+
+	VkDeviceSize bufferSize = drawCount * sizeof(VkDrawIndexedIndirectCommand);
+
+	// transparent draws scale with instance count, so the command buffers can outgrow their first size
+	if (drawCount > MAX_DRAW)
+		ensureBufferCapacity(drawCount);
+	// goes out with the upload batch of this frame
+	lveDevice.uploads().uploadBuffer(drawCommandsBuffer->getBuffer(), in.drawCommands.data(), bufferSize);
+}
 
-	stagingBuffer->writeToBuffer((void *) drawCommands.data());
+void RenderBucket::setInstance(Handle h, const glm::mat4& model, uint32_t meshId, uint32_t materialId,
+								bool transparent)
+{
+	Instance* instance = partition(h).get(localHandle(h));
+	if (!instance) return;
 
-	// Copy to persistent GPU buffer
-	lveDevice.copyBuffer(stagingBuffer->getBuffer(), drawCommandsBuffer->getBuffer(), bufferSize);
+	Object object;
+	object.setModel(model);
+	if (isStatic(h))
+	{
+		// only a real change is worth another upload of the whole static partition
+		if (instance->meshId == meshId && instance->materialId == materialId &&
+			std::memcmp(&instance->object, &object, sizeof(Object)) == 0)
+			return;
+		staticVersion.fetch_add(1, std::memory_order_relaxed);
+	}
 
+	instance->object = object;
+	instance->meshId = meshId;
+	instance->materialId = materialId;
+	if (!isStatic(h)) instance->transparent = transparent;
 }
 
 void RenderBucket::deleteInstance(Handle h)
 {
-	if (h.index >= bucket.size()) return;
-	generations[h.index]++; // invalidate handle
-	freeList.push_back(h.index);
-	deadList[h.index] = false;
+	if (partition(h).erase(localHandle(h)) && isStatic(h))
+		staticVersion.fetch_add(1, std::memory_order_relaxed);
 }
 
 Handle RenderBucket::addInstance( BucketSendData& item) {
-	Object o{ .model = item.model, .materialId = item.materialId };
+	Instance o{ .meshId = item.meshId, .materialId = item.materialId, .transparent = item.isTransparent };
+	o.object.setModel(item.model);
 	CpuObject c{ .entity = item.entity, .parent = item.parent };
 
-	uint32_t index = 0;
-	if (!freeList.empty()) {
-		index = freeList.back();
-		freeList.pop_back();
-		// reuse slot: overwrite both vectors
-		bucket[index] = o;
-		deadList[index] = true;
-		cpuBucket[index] = c;
-		// generation stays as-is (the handle returned must use current generation)
-	} else {
-		index = static_cast<uint32_t>(bucket.size());
-		bucket.push_back(o);
-		cpuBucket.push_back(c);
-		generations.push_back(0); // new slot generation starts at 0
-		deadList.push_back(true);
+	if (!item.isStatic || item.isTransparent)
+		return instances.insert(o, c);
+
+	Handle h = staticInstances.insert(o, c);
+	staticVersion.fetch_add(1, std::memory_order_relaxed);
+	h.index |= STATIC_HANDLE;
+	return h;
+}
+
+std::vector<Handle> RenderBucket::addInstances(std::span<const BucketSendData> items)
+{
+	// split by partition, each partition then takes its share in one bulk insert
+	std::vector<Instance> objects[2];
+	std::vector<CpuObject> cpuObjects[2];
+	auto isStaticItem = [](const BucketSendData& item) { return item.isStatic && !item.isTransparent; };
+	for (const BucketSendData& item: items)
+	{
+		Instance& o = objects[isStaticItem(item)].emplace_back();
+		o.object.setModel(item.model);
+		o.meshId = item.meshId;
+		o.materialId = item.materialId;
+		o.transparent = item.isTransparent;
+		cpuObjects[isStaticItem(item)].push_back(CpuObject{ .entity = item.entity, .parent = item.parent });
+	}
+
+	std::vector<Handle> partitionHandles[2];
+	partitionHandles[0].resize(objects[0].size());
+	partitionHandles[1].resize(objects[1].size());
+	instances.insert(objects[0], cpuObjects[0], partitionHandles[0]);
+	staticInstances.insert(objects[1], cpuObjects[1], partitionHandles[1]);
+	if (!objects[1].empty())
+		staticVersion.fetch_add(1, std::memory_order_relaxed);
+
+	// hand the handles back in the order the items came in
+	std::vector<Handle> handles(items.size());
+	size_t next[2] = {0, 0};
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		bool inStatic = isStaticItem(items[i]);
+		handles[i] = partitionHandles[inStatic][next[inStatic]++];
+		if (inStatic) handles[i].index |= STATIC_HANDLE;
+	}
+	return handles;
+}
+
+void RenderBucket::deleteInstances(std::span<const Handle> handles)
+{
+	std::vector<Handle> staticHandles;
+	std::vector<Handle> dynamicHandles;
+	dynamicHandles.reserve(handles.size());
+	for (const Handle& h: handles)
+	{
+		if (isStatic(h)) staticHandles.push_back(localHandle(h));
+		else dynamicHandles.push_back(h);
 	}
 
-	return Handle{ index, generations[index] };
+	instances.erase(dynamicHandles);
+	if (!staticHandles.empty())
+	{
+		staticInstances.erase(staticHandles);
+		staticVersion.fetch_add(1, std::memory_order_relaxed);
+	}
 }
 
+void RenderBucket::compact(uint32_t moveBudget)
+{
+	// start once a quarter of the storage is holes, then keep going until it is dense again
+	if (!compacting)
+		compacting = instances.capacity() > 64 && instances.holeCount() > instances.capacity() / 4;
+	if (compacting)
+		compacting = !instances.compact(moveBudget);
+
+	// static storage only shrinks, the gpu copy is built from a sorted walk and doesn't care where things sit
+	if (staticInstances.capacity() > 64 && staticInstances.holeCount() > staticInstances.capacity() / 4)
+		staticInstances.compact();
+}
 
 void RenderBucket::ensureBufferCapacity(uint32_t requiredCommandCount)
 {
@@ -220,17 +492,10 @@ void RenderBucket::ensureBufferCapacity(uint32_t requiredCommandCount)
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 	);
 
-	// Copy old data (if any) — copy old byte size
-	if (drawCommandsBuffer)
-	{
-		lveDevice.copyBuffer(
-			drawCommandsBuffer->getBuffer(),
-			newBuffer->getBuffer(),
-			currBytes
-		);
-	}
-
-	// swap and update capacity
+	// no need to carry the old commands over, createDrawCommand uploads the whole list right after.
+	// the frames in flight may still read the old buffer, it goes away once they are done
+	lveDevice.deletionQueue().retire(
+		[old = std::shared_ptr<lve::LveBuffer>(std::move(drawCommandsBuffer))]() mutable { old.reset(); });
 	drawCommandsBuffer = std::move(newBuffer);
 	MAX_DRAW = newCommandCapacity;
 }
@@ -247,17 +512,6 @@ void RenderBucket::createVertexBuffers(const std::vector<Vertex> &vertices)
 	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
 	uint32_t vertexSize = sizeof(vertices[0]);
 
-	lve::LveBuffer stagingBuffer{
-		lveDevice,
-		vertexSize,
-		vertexCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	};
-
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void *) vertices.data());
-
 	vertexBuffer = std::make_unique<lve::LveBuffer>(
 		lveDevice,
 		vertexSize,
@@ -265,7 +519,7 @@ void RenderBucket::createVertexBuffers(const std::vector<Vertex> &vertices)
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	lveDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+	lveDevice.uploads().uploadAsset(vertexBuffer->getBuffer(), vertices.data(), bufferSize);
 }
 
 void RenderBucket::createIndexBuffers(const std::vector<uint32_t> &indices)
@@ -275,17 +529,6 @@ void RenderBucket::createIndexBuffers(const std::vector<uint32_t> &indices)
 	VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
 	uint32_t indexSize = sizeof(indices[0]);
 
-	lve::LveBuffer stagingBuffer{
-		lveDevice,
-		indexSize,
-		indexCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	};
-
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void *) indices.data());
-
 	indexBuffer = std::make_unique<lve::LveBuffer>(
 		lveDevice,
 		indexSize,
@@ -293,7 +536,7 @@ void RenderBucket::createIndexBuffers(const std::vector<uint32_t> &indices)
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	lveDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+	lveDevice.uploads().uploadAsset(indexBuffer->getBuffer(), indices.data(), bufferSize);
 }
 
 
@@ -374,6 +617,18 @@ void Builder::loadModel(const std::string &filepath)
 	}
 }
 
+void Object::setModel(const glm::mat4 &model)
+{
+	// glm is column major, model[column][row]
+	for (int row = 0; row < 3; row++)
+		rows[row] = glm::vec4(model[0][row], model[1][row], model[2][row], model[3][row]);
+}
+
+glm::mat4 Object::model() const
+{
+	return glm::transpose(glm::mat4(rows[0], rows[1], rows[2], glm::vec4(0.f, 0.f, 0.f, 1.f)));
+}
+
 glm::mat4 TransformComponent::mat4()
 {
 	const float c3 = glm::cos(rotation.z);
@@ -2,12 +2,18 @@
 
 #include "lve_buffer.hpp"
 #include "lve_device.hpp"
+#include "lve_job_system.hpp"
+#include "lve_render_queue.hpp"
+#include "lve_slot_map.hpp"
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <atomic>
+#include <functional>
 #include <vector>
 #include <memory>
+#include <span>
 #include <unordered_map>
 #include "entt.hpp"
 
@@ -51,10 +57,35 @@ struct TransformComponent {
 	glm::mat3 normalMatrix();
 };
 
+// gpu instance record: the top three rows of the affine model matrix, the last row is always (0,0,0,1)
 struct Object {
-	glm::mat4 model;
-	uint32_t materialId;
-	uint32_t _pad[3];
+	glm::vec4 rows[3];
+
+	void setModel(const glm::mat4& model);
+	glm::mat4 model() const;
+};
+static_assert(sizeof(Object) == 48, "Object has to match the std430 layout in the shaders");
+
+// one entry of the material table, indexed by the per instance material id in shader.frag
+struct Material {
+	glm::vec4 baseColor{1.f}; // a is the opacity of transparent instances
+	int32_t albedoTexture = -1; // into the bindless texture array, -1 for none
+	uint32_t _pad[3]{};
+};
+static_assert(sizeof(Material) == 32, "Material has to match the std430 layout in shader.frag");
+
+// shader features a material needs, a variant is a mask of them. the bits follow the feature list
+// the scene pipelines are created with, see FirstApp::build
+namespace MaterialFeature {
+	constexpr uint32_t TEXTURED = 1u << 0; // samples albedoTexture
+}
+
+// what RenderBucket keeps per instance, the material goes into its own side array on upload
+struct Instance {
+	Object object;
+	uint32_t meshId; // which geometry, decides the draw
+	uint32_t materialId; // which material table entry, free to vary inside a draw
+	bool transparent = false; // drawn after opaques with blending, back to front
 };
 
 // i dont wanna explain this
@@ -66,44 +97,136 @@ struct CpuObject {
 // send this to RenderBucket
 struct BucketSendData {
 	glm::mat4 model;
+	uint32_t meshId;
 	uint32_t materialId;
 	entt::entity entity;
 	entt::entity parent;
+	bool isStatic = false; // never moves after creation, goes into the device local partition
+	bool isTransparent = false; // always dynamic, the order changes with the camera
+};
+
+// one instance in the transparent queue, the order is carried over between frames
+struct TransparentEntry {
+	Handle handle;
+	float depth;
+};
+
+// gpu buffers RenderBucket writes into, owned by whoever owns the descriptor sets
+struct BucketBuffers {
+	lve::LveBuffer* objects; // dynamic partition of the frame being uploaded, host visible, rewritten every time
+	lve::LveBuffer* materials;
+	lve::LveBuffer* staticObjects; // static partition, device local, only written when it changes
+	lve::LveBuffer* staticMaterials;
 };
 
-struct Handle {
-	uint32_t index;
-	uint32_t generation;
+// consecutive draws that use the same shader variant, one bind and one indirect call
+struct DrawRun {
+	uint32_t variant;
+	uint32_t firstDraw; // into BucketFrame::drawCommands
+	uint32_t drawCount;
 };
 
+// cpu side result of RenderBucket::buildFrame, consumed by RenderBucket::uploadFrame
+struct BucketFrame {
+	std::vector<Object> objects; // dynamic partition, sorted, in ssbo order
+	std::vector<uint32_t> materialIds; // parallel to objects
+	std::vector<VkDrawIndexedIndirectCommand> drawCommands; // static, then dynamic, then transparent draws
+	uint32_t opaqueDrawCount = 0; // everything after this is drawn by renderTransparent
+	std::vector<DrawRun> runs; // over drawCommands, opaque runs first
+	uint32_t opaqueRunCount = 0;
+
+	// static partition, only rebuilt when staticVersion falls behind the bucket
+	std::vector<Object> staticObjects;
+	std::vector<uint32_t> staticMaterialIds;
+	std::vector<VkDrawIndexedIndirectCommand> staticDrawCommands;
+	std::vector<DrawRun> staticRuns;
+	uint32_t staticVersion = ~0u;
+
+	// slot capacity of both partitions when this was built, every instance of the frame fits in them.
+	// the gpu buffers are sized from these, so a bulk spawn grows them once
+	uint32_t instanceCapacity = 0;
+	uint32_t staticCapacity = 0;
+
+	// back to front, nearly sorted already from the last time this frame was built
+	std::vector<TransparentEntry> transparentOrder;
+
+	// sort scratch, kept around so the queue doesn't allocate every frame
+	std::vector<lve::RenderQueueEntry> queue, queueScratch;
+	std::vector<uint8_t> transparentSeen;
+};
+
+using lve::Handle;
+
 
 class RenderBucket {
 public:
-	RenderBucket(lve::LveDevice &device, uint32_t MAX_DRAW, lve::LveBuffer& objectSSBO);
-	void createMeshes(const std::vector<std::string> &files);
+	// set on firstInstance of draws into the static partition, the shaders pick the buffer with it
+	static constexpr uint32_t STATIC_INSTANCE = 1u << 30;
+
+	RenderBucket(lve::LveDevice &device, uint32_t MAX_DRAW);
+	void createMeshes(const std::vector<std::string> &files, lve::LveJobSystem *jobSystem = nullptr);
 
 	Handle addInstance(BucketSendData &item);
 	void deleteInstance(Handle h);
-	void updateSSBO(lve::LveBuffer& objectSSBOA);
-	Object* get(const Handle& h) {
-		if (h.index >= bucket.size()) return nullptr;
-		if (generations[h.index] != h.generation) return nullptr; // stale handle
-		return &bucket[h.index];
+	// bulk versions, grow every array once and take free slots in one go
+	std::vector<Handle> addInstances(std::span<const BucketSendData> items);
+	void deleteInstances(std::span<const Handle> handles);
+	// moves live instances into a dense prefix once holes pile up, spread over frames by moveBudget.
+	// handles stay valid, only the storage behind them moves
+	void compact(uint32_t moveBudget = 4096);
+	const Instance* get(const Handle& h) const { return partition(h).get(localHandle(h)); } // null for stale handles
+	// writes go through here so the static partition knows when it has to be uploaded again
+	// transparency can only change on dynamic instances
+	void setInstance(Handle h, const glm::mat4& model, uint32_t meshId, uint32_t materialId, bool transparent = false);
+	static bool isStatic(Handle h) { return h.index & STATIC_HANDLE; }
+	// which shader variant draws instances of the material, 0 until set. set it before the frames are built
+	void setMaterialVariant(uint32_t materialId, uint32_t variant);
+	uint32_t variantOf(uint32_t materialId) const
+	{
+		return materialId < materialVariants.size() ? materialVariants[materialId] : 0;
 	}
 
-	void update(double deltaTime, lve::LveBuffer& objectSSBO);
-	void render(VkCommandBuffer commandBuffer);
-	std::unique_ptr<lve::LveBuffer> stagingBuffer;
+	void update(double deltaTime, const glm::vec3& cameraPosition, const BucketBuffers& buffers);
+	// build only reads instance data, upload only touches gpu buffers,
+	// so a simulation thread can build frame N+1 while frame N is uploaded.
+	// dynamic instances are sorted front to back from cameraPosition, maxDistance sets the depth precision
+	void buildFrame(BucketFrame& out, const glm::vec3& cameraPosition, float maxDistance = 1000.f) const;
+	// the buffers have to hold every instance of the frame, the owner grows them before this
+	void uploadFrame(const BucketFrame& in, const BucketBuffers& buffers);
+	// the static partition goes out again with the next upload, for when its buffers were replaced
+	void invalidateStaticUpload() { uploadedStaticVersion = ~0u; }
+	// bindVariant is called before every run of draws with the pipeline variant they need,
+	// without it every draw goes out with whatever pipeline is bound
+	void render(VkCommandBuffer commandBuffer, const std::function<void(uint32_t variant)>& bindVariant = {});
+	// needs a blending pipeline, call after render
+	void renderTransparent(VkCommandBuffer commandBuffer,
+							const std::function<void(uint32_t variant)>& bindVariant = {});
 
 private:
-	std::map<uint32_t, uint32_t> objectTypeIndex; // this is the batch it creates every
-	std::vector<Object> bucket; // holds drawable objects (unsorted)
-	std::vector<Object> sortedBucket; // sorts bucket every frame
-	std::vector<CpuObject> cpuBucket;
+	using InstanceMap = lve::LveSlotMap<Instance, CpuObject>;
+
+	// where a mesh sits in the shared vertex and index buffers
+	struct MeshRange {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t vertexOffset;
+	};
+
+	// marks handles into staticInstances, the rest of the index is the slot
+	static constexpr uint32_t STATIC_HANDLE = 1u << 31;
+	static Handle localHandle(Handle h) { return Handle{h.index & ~STATIC_HANDLE, h.generation}; }
+	InstanceMap& partition(Handle h) { return isStatic(h) ? staticInstances : instances; }
+	const InstanceMap& partition(Handle h) const { return isStatic(h) ? staticInstances : instances; }
 
-	std::vector<bool> deadList;
-	std::vector<uint32_t> generations; // stores how many times that slot has been reused
-	std::vector<uint32_t> freeList; // holds indices of deleted slots that can be reused
+	// drawable objects (unsorted), gpu data hot and entity links cold
+	InstanceMap instances;
+	InstanceMap staticInstances;
+	BucketFrame frame; // used by update() when build and upload happen back to back
+	bool compacting = false;
+	// bumped on every change to the static partition, atomic since transforms are written in parallel
+	std::atomic<uint32_t> staticVersion{0};
+	uint32_t uploadedStaticVersion = ~0u;
+	std::vector<uint8_t> materialVariants; // by material id, fits the pipeline bits of the render key
 
 	uint32_t MAX_DRAW;
 	uint32_t OBJECT_TYPES = 2;
@@ -116,16 +239,34 @@ private:
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
 	std::vector<Builder> builder;
-	std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+	std::vector<MeshRange> meshRanges;
+	uint32_t drawCount = 0; // commands in drawCommandsBuffer
+	uint32_t opaqueDrawCount = 0; // the rest of drawCommandsBuffer is transparent
+	std::vector<DrawRun> runs; // of drawCommandsBuffer
+	uint32_t opaqueRunCount = 0;
 	std::unique_ptr<lve::LveBuffer> drawCommandsBuffer;
 
 	void createVertexBuffers(const std::vector<Vertex> &vertices);
 	void createIndexBuffers(const std::vector<uint32_t> &indices);
 	void ensureBufferCapacity(uint32_t requiredCommandCount);
-	void createDrawCommand();
+	void updateSSBO(const BucketFrame& in, const BucketBuffers& buffers);
+	void uploadStatic(const BucketFrame& in, const BucketBuffers& buffers);
+	// keys and radix sorts one partition, writes its instances in key order and appends one draw per state run.
+	// without a camera position depth stays out of the key, instances of an unknown mesh are left out
+	void buildQueue(const InstanceMap& partition, const glm::vec3* cameraPosition, float maxDistance,
+					uint32_t instanceFlags, BucketFrame& scratch, std::vector<Object>& objects,
+					std::vector<uint32_t>& materialIds, std::vector<VkDrawIndexedIndirectCommand>& drawCommands,
+					std::vector<DrawRun>& runs) const;
+	// counts a new draw into the last run or starts one when the variant changes,
+	// runs before firstRun belong to another pass and are never extended
+	static void appendRun(std::vector<DrawRun>& runs, size_t firstRun, uint32_t variant, uint32_t drawIndex);
+	void drawRuns(VkCommandBuffer commandBuffer, const std::function<void(uint32_t variant)>& bindVariant,
+				uint32_t firstRun, uint32_t runCount, uint32_t firstDraw, uint32_t drawCount);
+	// updates the carried over back to front order and appends the transparent instances and draws to out
+	void buildTransparent(BucketFrame& out, const glm::vec3& cameraPosition) const;
+	void createDrawCommand(const BucketFrame& in);
 
 	lve::LveDevice &lveDevice;
-	lve::LveBuffer& objectSSBO;
 
 public:
 	static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
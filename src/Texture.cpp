@@ -4,20 +4,15 @@
 #include <stdexcept>
 
 #include "stb_image.h"
-#include "lve_buffer.hpp"
+#include "lve_upload_manager.hpp"
 
 VulkanTexture::VulkanTexture(lve::LveDevice &device, const std::string &filePath) : device(device)
 {
 	int width = 0, height = 0, channels = 0, bytesPerPixel = 0;
 
 	stbi_uc *data = stbi_load(filePath.c_str(), &width, &height, &channels, 4);
-
-	lve::LveBuffer stagingBuffer(device, 4, static_cast<uint32_t>(width * height),
-								VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-								VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer(data);
+	if (!data)
+		throw std::runtime_error("failed to load texture image!");
 
 	format = VK_FORMAT_R8G8B8A8_SRGB;
 
@@ -35,13 +30,11 @@ VulkanTexture::VulkanTexture(lve::LveDevice &device, const std::string &filePath
 	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	imageInfo.extent.depth = 1;
 
-	device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
-
-	transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
-
-	device.copyBufferToImage(stagingBuffer.getBuffer(), image, width, height, 1);
+	device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, allocation);
 
-	transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	// copied into the staging ring right away, the copy runs on the transfer queue after the next upload flush
+	device.uploads().uploadAsset(image, data, static_cast<VkDeviceSize>(width) * height * 4, imageInfo.extent);
+	stbi_image_free(data);
 
 	layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
@@ -97,7 +90,7 @@ device(device), sampler(sampler)
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+        device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, allocation);
 
         transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
         layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
@@ -170,8 +163,11 @@ void VulkanTexture::transitionImageLayout(VkImageLayout oldLayout, VkImageLayout
 
 VulkanTexture::~VulkanTexture()
 {
-	vkDestroyImage(device.device(), image, nullptr);
-	vkFreeMemory(device.device(), memory, nullptr);
-	vkDestroyImageView(device.device(), view, nullptr);
-	vkDestroySampler(device.device(), sampler, nullptr);
+	// descriptors of frames in flight may still point at it
+	device.deletionQueue().retire(
+		[&device = device, image = image, allocation = allocation, view = view, sampler = sampler]() mutable {
+			vkDestroyImageView(device.device(), view, nullptr);
+			vkDestroySampler(device.device(), sampler, nullptr);
+			device.allocator().destroyImage(image, allocation);
+		});
 }
\ No newline at end of file
@@ -19,7 +19,7 @@ public:
 
 	lve::LveDevice& device;
 	VkImage image;
-	VkDeviceMemory memory;
+	lve::LveAllocation allocation{};
 	VkImageView view;
 	VkSampler sampler;
 	VkFormat format;
@@ -1,16 +1,21 @@
 #include "coreRenderer.h"
 
+// std
+#include <algorithm>
+
 RenderSyncSystem::RenderSyncSystem(RenderBucket &bucket, lve::LveDevice &device,
-									lve::LveDescriptorSetLayout& descriptor) : renderBucket(bucket),
-	device(device)
+									lve::LveDescriptorSetLayout& descriptor, lve::LveJobSystem& jobSystem,
+									lve::LvePipelineBuildQueue* buildQueue) : renderBucket(bucket),
+	device(device), jobSystem(jobSystem)
 {
 	pointShadowRenderer = std::make_unique<lve::LvePointShadowRenderer>(device, shadowVert, shadowFrag,
-																		descriptor.getDescriptorSetLayout(),
+																		descriptor,
 																		RenderBucket::getBindingDescriptionsShadow,
-																		RenderBucket::getAttributeDescriptionsShadow);
+																		RenderBucket::getAttributeDescriptionsShadow,
+																		buildQueue);
 }
 
-void RenderSyncSystem::renderImGuiWindow(VkCommandBuffer commandBuffer, int WIDTH, int HEIGHT)
+void RenderSyncSystem::buildImGuiWindow(int WIDTH, int HEIGHT)
 {
 	ImGui_ImplVulkan_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
@@ -72,6 +77,16 @@ void RenderSyncSystem::renderImGuiWindow(VkCommandBuffer commandBuffer, int WIDT
 			ImGui::Spacing();
 			ImGui::Spacing();
 			ImGui::Text("Mesh ID");
+			if (ImGui::Button("<", ImVec2(20, 20)) && mesh->meshId > 0)
+				mesh->meshId--;
+			ImGui::SameLine();
+			ImGui::Text(std::to_string(mesh->meshId).c_str());
+			ImGui::SameLine();
+			if (ImGui::Button(">", ImVec2(20, 20)))
+				mesh->meshId++;
+
+			ImGui::PushID(1);
+			ImGui::Text("Material ID");
 			if (ImGui::Button("<", ImVec2(20, 20)) && mesh->materialId > 0)
 				mesh->materialId--;
 			ImGui::SameLine();
@@ -79,6 +94,8 @@ void RenderSyncSystem::renderImGuiWindow(VkCommandBuffer commandBuffer, int WIDT
 			ImGui::SameLine();
 			if (ImGui::Button(">", ImVec2(20, 20)))
 				mesh->materialId++;
+			ImGui::PopID();
+			ImGui::Checkbox("Transparent", &mesh->transparent);
 		}
 
 		if (auto *light = registry.try_get<lve::PointLightData>(currentEntity))
@@ -120,7 +137,7 @@ void RenderSyncSystem::renderImGuiWindow(VkCommandBuffer commandBuffer, int WIDT
 						true, // border
 						ImGuiWindowFlags_HorizontalScrollbar);
 
-		if (!registry.try_get<lve::PointLightData>(currentEntity))
+		if (currentEntity != entt::null && !registry.try_get<lve::PointLightData>(currentEntity))
 			if (ImGui::Selectable("Point Light"))
 				addLightComponent(currentEntity);
 
@@ -130,31 +147,142 @@ void RenderSyncSystem::renderImGuiWindow(VkCommandBuffer commandBuffer, int WIDT
 	}
 
 	ImGui::Render();
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
 }
 
 void RenderSyncSystem::deleteObject(entt::entity entity)
 {
-	auto &data = registry.get<DefaultObjectData>(currentEntity);
-	renderBucket.deleteInstance(data.handle);
-	registry.destroy(entity);
+	deleteObjects({&entity, 1});
 }
 
 
 void RenderSyncSystem::createObject()
 {
-	entt::entity e = registry.create();
-	TransformComponent& a = registry.emplace<TransformComponent>(e);
-	registry.emplace<MeshComponent>(e, 0);
-
-	BucketSendData data{};
-	data.model = a.mat4();
-	data.materialId = 0;
-	data.entity = static_cast<entt::entity>(e);
-	data.parent = static_cast<entt::entity>(entt::null);
-	Handle handle = renderBucket.addInstance(data);
-
-	registry.emplace<DefaultObjectData>(e, entt::null, handle, false);
+	spawnObject(TransformComponent{}, 0, 0, entt::null, false);
+}
+
+entt::entity RenderSyncSystem::spawnObject(const TransformComponent& transform, uint32_t meshId, uint32_t materialId,
+											entt::entity parent, bool isStatic)
+{
+	return spawnObjects({&transform, 1}, meshId, materialId, parent, isStatic).front();
+}
+
+std::vector<entt::entity> RenderSyncSystem::spawnObjects(std::span<const TransformComponent> transforms,
+														uint32_t meshId, uint32_t materialId, entt::entity parent,
+														bool isStatic)
+{
+	std::vector<entt::entity> entities(transforms.size());
+	if (entities.empty()) return entities;
+
+	registry.create(entities.begin(), entities.end());
+	registry.insert<TransformComponent>(entities.begin(), entities.end(), transforms.begin());
+	registry.insert<MeshComponent>(entities.begin(), entities.end(), MeshComponent{meshId, materialId});
+
+	std::vector<BucketSendData> sendData(entities.size());
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		auto &transform = registry.get<TransformComponent>(entities[i]);
+		sendData[i].model = transform.mat4();
+		sendData[i].meshId = meshId;
+		sendData[i].materialId = materialId;
+		sendData[i].entity = entities[i];
+		sendData[i].parent = parent;
+		sendData[i].isStatic = isStatic;
+		// mat4() clears the flag, the world matrix still has to be built by updateTransforms
+		transform.dirty = true;
+	}
+
+	std::vector<Handle> handles = renderBucket.addInstances(sendData);
+
+	std::vector<DefaultObjectData> meta(entities.size());
+	for (size_t i = 0; i < entities.size(); i++)
+		meta[i] = DefaultObjectData{parent, handles[i], false};
+	registry.insert<DefaultObjectData>(entities.begin(), entities.end(), meta.begin());
+
+	return entities;
+}
+
+void RenderSyncSystem::deleteObjects(std::span<const entt::entity> entities)
+{
+	// registry.valid can't catch an entity listed twice, both copies would reach registry.destroy
+	std::vector<entt::entity> unique(entities.begin(), entities.end());
+	std::sort(unique.begin(), unique.end());
+	unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+	std::vector<entt::entity> alive;
+	std::vector<Handle> handles;
+	alive.reserve(unique.size());
+	handles.reserve(unique.size());
+
+	for (entt::entity entity: unique)
+	{
+		if (!registry.valid(entity)) continue;
+		alive.push_back(entity);
+		handles.push_back(registry.get<DefaultObjectData>(entity).handle);
+
+		if (currentEntity == entity)
+		{
+			currentEntity = entt::null;
+			enableEditor = false;
+		}
+	}
+
+	renderBucket.deleteInstances(handles);
+	registry.destroy(alive.begin(), alive.end());
+}
+
+size_t RenderSyncSystem::applyCommands()
+{
+	return commandQueue.drain([this](SceneCommand& command) { applyCommand(command); });
+}
+
+void RenderSyncSystem::applyCommand(SceneCommand& command)
+{
+	if (command.type == SceneCommand::Type::spawn)
+	{
+		// a parent that died before the spawn got applied leaves the object at the root
+		entt::entity parent = registry.valid(command.entity) ? command.entity : entt::null;
+
+		TransformComponent transform{};
+		transform.translation = command.translation;
+		transform.rotation = command.rotation;
+		transform.scale = command.scale;
+
+		entt::entity e = spawnObject(transform, command.meshId, command.materialId, parent,
+									command.isStatic && !command.isTransparent);
+		registry.get<MeshComponent>(e).transparent = command.isTransparent;
+		if (command.onSpawned)
+			command.onSpawned(e);
+		return;
+	}
+
+	// the entity may have been destroyed by an earlier command or the editor
+	if (!registry.valid(command.entity)) return;
+
+	switch (command.type)
+	{
+		case SceneCommand::Type::destroy:
+			deleteObject(command.entity);
+			break;
+		case SceneCommand::Type::setTransform:
+			if (auto *transform = registry.try_get<TransformComponent>(command.entity))
+			{
+				transform->translation = command.translation;
+				transform->rotation = command.rotation;
+				transform->scale = command.scale;
+				transform->dirty = true;
+			}
+			break;
+		case SceneCommand::Type::setMesh:
+			if (auto *mesh = registry.try_get<MeshComponent>(command.entity))
+				mesh->meshId = command.meshId;
+			break;
+		case SceneCommand::Type::setMaterial:
+			if (auto *mesh = registry.try_get<MeshComponent>(command.entity))
+				mesh->materialId = command.materialId;
+			break;
+		default:
+			break;
+	}
 }
 
 void RenderSyncSystem::addLightComponent(entt::entity entity)
@@ -177,23 +305,18 @@ void RenderSyncSystem::removeLightComponent(entt::entity entity)
 }
 
 
-void RenderSyncSystem::syncToRenderBucket(VkDescriptorSet& descriptor, lve::LveBuffer& buffer)
+void RenderSyncSystem::collectLights(std::vector<lve::LightSnapshot>& out)
 {
-	auto view = registry.view<DefaultObjectData>();
-	for (auto [entity, data] : view.each())
+	out.clear();
+	auto view = registry.view<lve::PointLightData>();
+	for (auto [entity, light] : view.each())
 	{
-		if (!data.dirty) return;
-		if (TransformComponent *transform = registry.try_get<TransformComponent>(currentEntity))
-			if (transform->dirty)
-				updateTransformRecursive(entity, transform->worldMatrix, true);
-
-		if (lve::PointLightData *light = registry.try_get<lve::PointLightData>(currentEntity))
-			if (light->dirty)
-			{
-				light->update();
-				light->updateDescriptorSet(device, descriptor);
-				light->updateBuffer(buffer);
-			}
+		if (light.dirty)
+		{
+			light.update();
+			light.dirty = false;
+		}
+		out.push_back({light.light, light.shadowMap});
 	}
 
 	dirtyLight.clear();
@@ -204,17 +327,27 @@ void RenderSyncSystem::updateTransforms()
 	auto view = registry.view<TransformComponent, DefaultObjectData>();
 
 	// Find root entities (no parent)
+	rootEntities.clear();
 	for (auto [entity, transform, meta]: view.each())
 	{
 		if (meta.parent == entt::null)
+			rootEntities.push_back(entity);
+	}
+
+	// every root owns a disjoint subtree, so they can be updated side by side
+	jobSystem.parallelFor(static_cast<uint32_t>(rootEntities.size()), 64, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++)
 		{
+			entt::entity entity = rootEntities[i];
 			updateTransformRecursive(entity, glm::mat4(1.0f), true);
 
+			auto &transform = registry.get<TransformComponent>(entity);
+			auto &meta = registry.get<DefaultObjectData>(entity);
 			auto &mesh = registry.get<MeshComponent>(entity);
-			renderBucket.get(meta.handle)->model = transform.worldMatrix;
-			renderBucket.get(meta.handle)->materialId = mesh.materialId;
+			renderBucket.setInstance(meta.handle, transform.worldMatrix, mesh.meshId, mesh.materialId,
+									mesh.transparent);
 		}
-	}
+	});
 }
 
 void RenderSyncSystem::updateTransformRecursive(entt::entity entity, const glm::mat4 &parentMatrix, bool parentDirty)
@@ -10,6 +10,10 @@
 #include "Mesh.h"
 #include "lve_light.h"
 #include "lve_descriptors.hpp"
+#include "lve_job_system.hpp"
+#include "lve_pipeline_build_queue.hpp"
+#include "lve_mpsc_queue.hpp"
+#include "lve_render_snapshot.hpp"
 
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
@@ -20,6 +24,10 @@
 #include "imstb_textedit.h"
 #include "imstb_truetype.h"
 
+// std
+#include <functional>
+#include <span>
+
 struct InstanceData {
 	glm::mat4 model;
 	uint32_t materialId;
@@ -27,7 +35,9 @@ struct InstanceData {
 };
 
 struct MeshComponent {
+	uint32_t meshId = 0;
 	uint32_t materialId = 0;
+	bool transparent = false;
 };
 
 struct DefaultObjectData {
@@ -36,15 +46,46 @@ struct DefaultObjectData {
 	bool dirty = true;
 };
 
+// scene edit that can be queued from any thread and is applied by the thread owning the registry
+struct SceneCommand {
+	enum class Type : uint8_t { spawn, destroy, setTransform, setMesh, setMaterial };
+
+	Type type = Type::spawn;
+	entt::entity entity = entt::null; // target, or the parent for spawn
+	glm::vec3 translation{};
+	glm::vec3 rotation{};
+	glm::vec3 scale{1.f, 1.f, 1.f};
+	uint32_t meshId = 0;
+	uint32_t materialId = 0;
+	bool isStatic = false; // spawn only
+	bool isTransparent = false; // spawn only, transparent objects are never static
+	// spawn only, runs on the owning thread with the new entity
+	std::function<void(entt::entity)> onSpawned;
+};
+
 class RenderSyncSystem {
 public:
-	RenderSyncSystem(RenderBucket& bucket, lve::LveDevice& device, lve::LveDescriptorSetLayout& descriptor);
+	RenderSyncSystem(RenderBucket& bucket, lve::LveDevice& device, lve::LveDescriptorSetLayout& descriptor,
+					lve::LveJobSystem& jobSystem, lve::LvePipelineBuildQueue* buildQueue = nullptr);
 	~RenderSyncSystem() = default;
 
-	void renderImGuiWindow(VkCommandBuffer commandBuffer, int WIDTH, int HEIGHT);
-	void syncToRenderBucket(VkDescriptorSet& descriptor, lve::LveBuffer& buffer);
+	// runs the imgui frame up to ImGui::Render, the draw data is recorded by whoever renders the frame
+	void buildImGuiWindow(int WIDTH, int HEIGHT);
+	void collectLights(std::vector<lve::LightSnapshot>& out);
 	void updateTransforms();
 
+	// thread safe, commands are applied on the next applyCommands
+	void enqueue(SceneCommand command) { commandQueue.push(std::move(command)); }
+	// owning thread only, returns the number of commands applied
+	size_t applyCommands();
+
+	// creates one entity per transform with a single allocation per component pool
+	// static objects are uploaded once into the device local partition, moving them is allowed but costly
+	std::vector<entt::entity> spawnObjects(std::span<const TransformComponent> transforms, uint32_t meshId,
+											uint32_t materialId = 0, entt::entity parent = entt::null,
+											bool isStatic = false);
+	void deleteObjects(std::span<const entt::entity> entities);
+
 	// get stuff
 	entt::registry& getRegistery() {return registry; }
 	lve::LvePointShadowRenderer& getPointShadowRenderer() const {return *pointShadowRenderer; }
@@ -59,11 +100,17 @@ private:
 	void addLightComponent(entt::entity entity);
 	void removeLightComponent(entt::entity entity);
 	void deleteObject(entt::entity entity);
+	entt::entity spawnObject(const TransformComponent& transform, uint32_t meshId, uint32_t materialId,
+							entt::entity parent, bool isStatic);
+	void applyCommand(SceneCommand& command);
 
 	// main stuff
 	entt::registry registry;
 	RenderBucket& renderBucket;
 	lve::LveDevice& device;
+	lve::LveJobSystem& jobSystem;
+	std::vector<entt::entity> rootEntities;
+	lve::LveMpscQueue<SceneCommand> commandQueue;
 
 	// dirty bucket
 	std::vector<entt::entity> dirtyLight;
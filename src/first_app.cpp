@@ -1,5 +1,7 @@
 #include "first_app.hpp"
 #include "lve_buffer.hpp"
+#include "lve_pipeline_library.hpp"
+#include "lve_upload_manager.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -14,7 +16,10 @@
 #include <iomanip>
 #include <stdexcept>
 #include <algorithm>
+#include <exception>
 #include <random>
+#include <sstream>
+#include <thread>
 
 namespace lve {
 	FirstApp::FirstApp()
@@ -24,22 +29,24 @@ namespace lve {
 				// global ubo
 				.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 							LveSwapChain::MAX_FRAMES_IN_FLIGHT)
-				// game objects
-				.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
-
-				// lights
-				.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
+				// per set: game objects, lights, instance materials, static instances and their materials,
+				// material table
+				.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+							6 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
 
 				// bindless textures
 				.setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
 				.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 							1000)
 
+				// shadow map
 				.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-							1)
+							LveSwapChain::MAX_FRAMES_IN_FLIGHT)
 
 				.build();
 
+		lveRenderer.createSecondaryCommandPools(jobSystem.getThreadCount());
+
 		loadGameObjects();
 		buildPreDescriptor();
 		buildDescriptors();
@@ -53,81 +60,323 @@ namespace lve {
 
 	void FirstApp::run()
 	{
+		// started here rather than in the constructor, the flag is set after construction
+		if (hotReloadShaders && !shaderWatcher)
+		{
+			auto &library = lveDevice.pipelineLibrary();
+			shaderWatcher = std::make_unique<LveShaderWatcher>(
+				library.getShaderPaths(), [this, &library](const std::string &path) {
+					if (library.reload(path) > 0)
+						requestRedraw();
+				});
+		}
+
+		if (threadedRendering)
+		{
+			runThreaded();
+			return;
+		}
+
+		RenderSnapshot &frame = snapshots[0];
 		while (!lveWindow.shouldClose())
 		{
-			// update stuff
-			glfwPollEvents();
-			currentTime = glfwGetTime();
-			deltaTime = currentTime - lastTime;
-			lastTime = currentTime;
-			aspect = lveRenderer.getAspectRatio();
-			WIDTH = static_cast<int>(lveWindow.getExtent().width);
-			HEIGHT = static_cast<int>(lveWindow.getExtent().height);
-
-			if (VkCommandBuffer commandBuffer = startFrame())
-			{
-				frameIndex = lveRenderer.getFrameIndex();
+			pumpEvents(true);
+			simulate(frame);
+			if (consumeRedraw())
+				submit(frame);
+		}
 
-				update(commandBuffer);
-				//updateShadow();
-				render(commandBuffer);
-				renderImGui(commandBuffer);
+		vkDeviceWaitIdle(lveDevice.device());
+	}
 
-				endFrame(commandBuffer);
+	void FirstApp::runThreaded()
+	{
+		// snapshots cycle between the two queues, so simulation runs at most one frame ahead of rendering
+		LveFrameQueue<RenderSnapshot *> pendingFrames{snapshots.size()}, freeFrames{snapshots.size()};
+		for (auto &snapshot: snapshots)
+			freeFrames.push(&snapshot);
+
+		// glfw events can only be pumped here, the render thread must not block on them.
+		// just in time input has no effect here, simulation is decoupled from the frame wait
+		lveRenderer.setWaitForEvents(false);
+
+		std::exception_ptr renderError;
+		std::thread renderThread([&]() {
+			try
+			{
+				RenderSnapshot *frame;
+				while (pendingFrames.pop(frame))
+				{
+					submit(*frame);
+					freeFrames.push(frame);
+				}
+			} catch (...)
+			{
+				renderError = std::current_exception();
+				freeFrames.close();
+			}
+		});
+
+		std::exception_ptr simulationError;
+		try
+		{
+			RenderSnapshot *frame;
+			while (!lveWindow.shouldClose() && freeFrames.pop(frame))
+			{
+				pumpEvents(false);
+				simulate(*frame);
+				// an idle frame is never handed over, the snapshot is simply written again next time
+				if (consumeRedraw())
+					pendingFrames.push(frame);
+				else
+					freeFrames.push(frame);
 			}
+		} catch (...)
+		{
+			simulationError = std::current_exception();
 		}
 
+		pendingFrames.close();
+		freeFrames.close();
+		renderThread.join();
+
 		vkDeviceWaitIdle(lveDevice.device());
+		lveRenderer.setWaitForEvents(true);
+
+		if (renderError) std::rethrow_exception(renderError);
+		if (simulationError) std::rethrow_exception(simulationError);
 	}
 
+	void FirstApp::requestRedraw()
+	{
+		redrawRequested = true;
+		lveWindow.wakeUp();
+	}
 
-	void FirstApp::update(VkCommandBuffer &commandBuffer)
+	void FirstApp::markDirty()
 	{
+		redrawFrames = REDRAW_FRAMES;
+	}
+
+	void FirstApp::pumpEvents(bool justInTimeInput)
+	{
+		if (idleRendering && redrawFrames == 0 && !redrawRequested)
+		{
+			// nothing to draw, sleep until an event arrives. the timeout picks up scene commands and
+			// uploads queued by other threads that did not call requestRedraw
+			glfwWaitEventsTimeout(IDLE_TIMEOUT);
+		} else
+		{
+			// low latency profiles wait for the gpu before input is read instead of after
+			if (justInTimeInput && lveRenderer.getLatencyProfile().justInTimeInput)
+				lveRenderer.waitForNextFrame();
+			glfwPollEvents();
+		}
+
+		uint64_t eventCount = lveWindow.getEventCount();
+		if (eventCount != lastEventCount)
+		{
+			lastEventCount = eventCount;
+			markDirty();
+		}
+		if (redrawRequested.exchange(false))
+			markDirty();
+	}
+
+	bool FirstApp::consumeRedraw()
+	{
+		if (!idleRendering) return true;
+		if (redrawFrames == 0) return false;
+		redrawFrames--;
+		return true;
+	}
+
+	void FirstApp::simulate(RenderSnapshot &frame)
+	{
+		// update stuff
+		frame.inputTime = std::chrono::steady_clock::now();
+		currentTime = glfwGetTime();
+		deltaTime = currentTime - lastTime;
+		lastTime = currentTime;
+		WIDTH = static_cast<int>(lveWindow.getExtent().width);
+		HEIGHT = static_cast<int>(lveWindow.getExtent().height);
+		if (HEIGHT > 0)
+			aspect = static_cast<float>(WIDTH) / static_cast<float>(HEIGHT);
+
+		updateLatencyProfile();
+		glm::vec3 camPos = ubo.camPos, camRotation = ubo.rotation;
 		camera.update(lveWindow.getGLFWwindow(), static_cast<float>(deltaTime), ubo);
-		uboBuffers[frameIndex]->writeToBuffer(&ubo);
-		uboBuffers[frameIndex]->flush();
+		// held movement keys don't send events, a moving camera counts as animation
+		if (ubo.camPos != camPos || ubo.rotation != camRotation)
+			markDirty();
+		frame.ubo = ubo;
+		frame.deltaTime = deltaTime;
 
 		// update title
 		if (currentTime - lastUpdate1 > .5)
 		{
 			double fps = 1. / (deltaTime);
+			LatencyMode mode = lveRenderer.getLatencyProfile().mode;
 			std::ostringstream title;
-			title << "FPS: " << std::fixed << std::setprecision(1) << fps;
-			lveWindow.setName(std::to_string(fps));
+			title << "FPS: " << std::fixed << std::setprecision(1) << fps
+					<< " | " << latencyModeName(mode) << " latency: " << lveRenderer.getMeasuredLatency(mode) << " ms";
+			lveWindow.setName(title.str());
 			lastUpdate1 = currentTime;
 		}
 
+		// edits queued by other threads since the last frame
+		if (renderSyncSystem->applyCommands() > 0)
+			markDirty();
+		if (lveDevice.uploads().hasPendingWork())
+			markDirty();
 		renderSyncSystem->updateTransforms();
-		renderSyncSystem->syncToRenderBucket(globalDescriptorSets[frameIndex], *pointLightBuffer);
-		renderBucket.update(deltaTime, *drawSSBO);
+		renderBucket.compact();
+		renderBucket.buildFrame(frame.bucket, frame.ubo.camPos, camera.farPlane);
+		renderSyncSystem->collectLights(frame.lights);
+
+		// imgui keeps global state, the render thread only touches it while holding the same lock
+		std::lock_guard<std::mutex> lock(imGuiMutex);
+		renderSyncSystem->buildImGuiWindow(WIDTH, HEIGHT);
+		frame.imGui.capture(ImGui::GetDrawData(), threadedRendering);
 	}
 
-	void FirstApp::updateShadow()
+	void FirstApp::submit(RenderSnapshot &frame)
 	{
-		VkCommandBuffer cmd = lveDevice.beginSingleTimeCommands();
-		renderSyncSystem->getPointShadowRenderer().bindPipeline(cmd);
-		vkCmdBindDescriptorSets(
-			cmd,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			renderSyncSystem->getPointShadowRenderer().getPipelineLayout(),
-			0,
-			1,
-			&globalDescriptorSets[frameIndex],
-			0,
-			nullptr
-		);
+		// frame boundary, nothing is recording. the replaced pipelines are retired with this frame
+		lveDevice.pipelineLibrary().applyReloads();
 
-		renderSyncSystem->getLightIndex(0).shadowMap->beginRender(cmd, renderSyncSystem->getPointShadowRenderer().getRenderPass(),
-											renderSyncSystem->getPointShadowRenderer().getFramebuffer(shadowExtent));
-		renderBucket.render(cmd);
-		renderSyncSystem->getLightIndex(0).shadowMap->endRender(cmd);
-		lveDevice.endSingleTimeCommands(cmd);
-		renderSyncSystem->getLightIndex(0).updateDescriptorSet(lveDevice, globalDescriptorSets[frameIndex]);
+		if (VkCommandBuffer commandBuffer = startFrame())
+		{
+			frameIndex = lveRenderer.getFrameIndex();
+			lveRenderer.setFrameInputTime(frame.inputTime);
+			jobSystem.beginFrame();
+
+			upload(frame);
+			render(commandBuffer, frame);
+
+			jobSystem.endFrame();
+			endFrame(commandBuffer);
+		}
 	}
 
-	void FirstApp::render(VkCommandBuffer &commandBuffer)
+	void FirstApp::upload(RenderSnapshot &frame)
+	{
+		uboBuffers[frameIndex]->writeToBuffer(&frame.ubo);
+		uboBuffers[frameIndex]->flush();
+
+		// the shaders loop over all MAX_LIGHT_COUNT entries, the ones without a light are cleared
+		uint32_t lightCount = std::min(static_cast<uint32_t>(frame.lights.size()), MAX_LIGHT_COUNT);
+		auto *lights = static_cast<PointLight *>(pointLightBuffers[frameIndex]->getMappedMemory());
+		for (uint32_t i = 0; i < MAX_LIGHT_COUNT; i++)
+			lights[i] = i < lightCount ? frame.lights[i].light : PointLight{};
+		pointLightBuffers[frameIndex]->flush();
+
+		// the shadow map binding only holds a single light for now
+		if (!frame.lights.empty() && frame.lights[0].shadowMap)
+		{
+			auto imageInfo = frame.lights[0].shadowMap->descriptorInfo();
+			LveDescriptorWriter(*globalSetLayout, *globalPool)
+					.writeImage(4, &imageInfo)
+					.overwrite(globalDescriptorSets[frameIndex]);
+		}
+
+		ensureInstanceCapacity(frame.bucket);
+		renderBucket.uploadFrame(frame.bucket, {
+			drawSSBOs[frameIndex].get(), materialSSBOs[frameIndex].get(), staticSSBO.get(), staticMaterialSSBO.get()
+		});
+
+		// submitted ahead of the frame, so its draws see the new data
+		lveDevice.uploads().flush();
+	}
+
+	void FirstApp::ensureInstanceCapacity(const BucketFrame &bucket)
+	{
+		// sized from the bucket rather than the frame, a bulk spawn grows once instead of over several frames
+		uint32_t dynamicCount = std::max(bucket.instanceCapacity, static_cast<uint32_t>(bucket.objects.size()));
+		uint32_t staticCount = std::max(bucket.staticCapacity, static_cast<uint32_t>(bucket.staticObjects.size()));
+
+		// the streaming buffers belong to this frame alone
+		bool grown = growBuffer(drawSSBOs[frameIndex], dynamicCount);
+		grown |= growBuffer(materialSSBOs[frameIndex], dynamicCount);
+
+		// the static ones are shared, the other frames' sets are updated when their turn comes
+		if (growBuffer(staticSSBO, staticCount) | growBuffer(staticMaterialSSBO, staticCount))
+		{
+			// the new static buffers start out empty
+			renderBucket.invalidateStaticUpload();
+			staticBuffersVersion++;
+		}
+
+		// only this frame's set is safe to update, the others may still be in flight
+		if (grown || instanceDescriptorVersions[frameIndex] != staticBuffersVersion)
+		{
+			writeInstanceDescriptors(frameIndex);
+			instanceDescriptorVersions[frameIndex] = staticBuffersVersion;
+		}
+	}
+
+	bool FirstApp::growBuffer(std::unique_ptr<LveBuffer> &buffer, uint32_t count)
+	{
+		if (count <= buffer->getInstanceCount()) return false;
+
+		// doubling keeps a steady spawn rate from growing every frame
+		uint32_t capacity = std::max(count, buffer->getInstanceCount() * 2);
+		auto grown = std::make_unique<LveBuffer>(
+			lveDevice, buffer->getInstanceSize(), capacity,
+			buffer->getUsageFlags(), buffer->getMemoryPropertyFlags());
+		if (buffer->getMappedMemory() != nullptr)
+			grown->map();
+
+		// frames in flight may still read the old one
+		lveDevice.deletionQueue().retire(
+			[old = std::shared_ptr<LveBuffer>(std::move(buffer))]() mutable { old.reset(); });
+		buffer = std::move(grown);
+		return true;
+	}
+
+	void FirstApp::writeInstanceDescriptors(int frame)
+	{
+		auto drawBufferInfo = drawSSBOs[frame]->descriptorInfo();
+		auto materialBufferInfo = materialSSBOs[frame]->descriptorInfo();
+		auto staticBufferInfo = staticSSBO->descriptorInfo();
+		auto staticMaterialBufferInfo = staticMaterialSSBO->descriptorInfo();
+
+		LveDescriptorWriter(*globalSetLayout, *globalPool)
+				.writeBuffer(1, &drawBufferInfo)
+				.writeBuffer(5, &materialBufferInfo)
+				.writeBuffer(6, &staticBufferInfo)
+				.writeBuffer(7, &staticMaterialBufferInfo)
+				.overwrite(globalDescriptorSets[frame]);
+	}
+
+	void FirstApp::render(VkCommandBuffer &commandBuffer, RenderSnapshot &frame)
+	{
+		// scene and imgui are recorded side by side into secondary buffers, then executed in order
+		VkCommandBuffer passes[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+		JobCounter recording;
+
+		jobSystem.run([&]() {
+			passes[0] = lveRenderer.beginSecondaryCommandBuffer(jobSystem.getThreadIndex());
+			recordScene(passes[0]);
+			lveRenderer.endSecondaryCommandBuffer(passes[0]);
+		}, &recording);
+
+		// the imgui frame was built on the simulation thread, glfw and the editor only run there.
+		// this job only records the captured draw data
+		jobSystem.run([&]() {
+			passes[1] = lveRenderer.beginSecondaryCommandBuffer(jobSystem.getThreadIndex());
+			renderImGui(passes[1], frame.imGui);
+			lveRenderer.endSecondaryCommandBuffer(passes[1]);
+		}, &recording);
+
+		jobSystem.wait(recording);
+
+		lveRenderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		vkCmdExecuteCommands(commandBuffer, 2, passes);
+	}
+
+	void FirstApp::recordScene(VkCommandBuffer commandBuffer)
 	{
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, simpleRenderSystem->getPipeline());
 		vkCmdBindDescriptorSets(
 			commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -138,12 +387,24 @@ namespace lve {
 			0,
 			nullptr);
 
-		renderBucket.render(commandBuffer);
+		// draws are grouped by variant, so each variant is bound once per pass
+		renderBucket.render(commandBuffer, [&](uint32_t variant) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, simpleRenderSystem->getPipeline(variant));
+		});
+
+		// same set layout, so the descriptor set bound above stays valid
+		renderBucket.renderTransparent(commandBuffer, [&](uint32_t variant) {
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+							transparentRenderSystem->getPipeline(variant));
+		});
 	}
 
-	void FirstApp::renderImGui(VkCommandBuffer &commandBuffer)
+	void FirstApp::renderImGui(VkCommandBuffer commandBuffer, ImGuiSnapshot &imGui)
 	{
-		renderSyncSystem->renderImGuiWindow(commandBuffer, WIDTH, HEIGHT);
+		if (imGui.drawData == nullptr) return;
+
+		std::lock_guard<std::mutex> lock(imGuiMutex);
+		ImGui_ImplVulkan_RenderDrawData(imGui.drawData, commandBuffer);
 	}
 
 
@@ -162,17 +423,63 @@ namespace lve {
 			uboBuffers[i]->map();
 		}
 
-		drawSSBO = std::make_unique<LveBuffer>(
-			lveDevice, sizeof(Object) * MAX_OBJECT_COUNT, 1,
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-		drawSSBO->map();
+		// instance buffers start at these sizes and grow with the scene, see ensureInstanceCapacity
+		for (int i = 0; i < drawSSBOs.size(); i++)
+		{
+			drawSSBOs[i] = std::make_unique<LveBuffer>(
+				lveDevice, sizeof(Object), MAX_OBJECT_COUNT,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			drawSSBOs[i]->map();
+
+			materialSSBOs[i] = std::make_unique<LveBuffer>(
+				lveDevice, sizeof(uint32_t), MAX_OBJECT_COUNT,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			materialSSBOs[i]->map();
+		}
+
+		// static partition, only written through staging copies
+		staticSSBO = std::make_unique<LveBuffer>(
+			lveDevice, sizeof(Object), MAX_STATIC_OBJECT_COUNT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		staticMaterialSSBO = std::make_unique<LveBuffer>(
+			lveDevice, sizeof(uint32_t), MAX_STATIC_OBJECT_COUNT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		// material 0 is plain white, after that one material per loaded texture
+		std::vector<Material> materials(1);
+		for (int i = 0; i < textures.size(); i++)
+			materials.push_back({.albedoTexture = i});
+		if (materials.size() > MAX_MATERIAL_COUNT)
+			throw std::runtime_error("failed to create material table, too many materials!");
 
-		pointLightBuffer = std::make_unique<LveBuffer>(
-			lveDevice, sizeof(PointLight) * 1, 1,
+		// every material is drawn by the leanest shader variant that covers it
+		for (uint32_t i = 0; i < materials.size(); i++)
+		{
+			uint32_t variant = materials[i].albedoTexture >= 0 ? MaterialFeature::TEXTURED : 0;
+			renderBucket.setMaterialVariant(i, variant);
+			if (std::find(materialVariants.begin(), materialVariants.end(), variant) == materialVariants.end())
+				materialVariants.push_back(variant);
+		}
+
+		materialTableSSBO = std::make_unique<LveBuffer>(
+			lveDevice, sizeof(Material), MAX_MATERIAL_COUNT,
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-		pointLightBuffer->map();
+		materialTableSSBO->map();
+		materialTableSSBO->writeToBuffer(materials.data(), sizeof(Material) * materials.size());
+
+		for (auto &pointLightBuffer: pointLightBuffers)
+		{
+			pointLightBuffer = std::make_unique<LveBuffer>(
+				lveDevice, sizeof(PointLight), MAX_LIGHT_COUNT,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			pointLightBuffer->map();
+		}
 
 		// create Texture
 		std::vector<VkDescriptorImageInfo> imageInfos;
@@ -198,6 +505,14 @@ namespace lve {
 
 				.addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, // shadowmap
 							VK_SHADER_STAGE_FRAGMENT_BIT)
+				.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // instance materials
+							VK_SHADER_STAGE_ALL)
+				.addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // static instances
+							VK_SHADER_STAGE_ALL)
+				.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // static instance materials
+							VK_SHADER_STAGE_ALL)
+				.addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // material table
+							VK_SHADER_STAGE_FRAGMENT_BIT)
 				.build();
 
 
@@ -205,39 +520,91 @@ namespace lve {
 		for (int i = 0; i < globalDescriptorSets.size(); i++)
 		{
 			auto bufferInfo = uboBuffers[i]->descriptorInfo();
-			auto drawBufferInfo = drawSSBO->descriptorInfo();
-			auto pointLightBufferInfo = pointLightBuffer->descriptorInfo();
+			auto drawBufferInfo = drawSSBOs[i]->descriptorInfo();
+			auto pointLightBufferInfo = pointLightBuffers[i]->descriptorInfo();
+			auto materialBufferInfo = materialSSBOs[i]->descriptorInfo();
+			auto staticBufferInfo = staticSSBO->descriptorInfo();
+			auto staticMaterialBufferInfo = staticMaterialSSBO->descriptorInfo();
+			auto materialTableInfo = materialTableSSBO->descriptorInfo();
 
 			LveDescriptorWriter(*globalSetLayout, *globalPool)
 					.writeBuffer(0, &bufferInfo)
 					.writeBuffer(1, &drawBufferInfo)
 					.writeBuffer(2, &pointLightBufferInfo)
 					.writeImages(3, imageInfos.data(), static_cast<uint32_t>(imageInfos.size()))
+					.writeBuffer(5, &materialBufferInfo)
+					.writeBuffer(6, &staticBufferInfo)
+					.writeBuffer(7, &staticMaterialBufferInfo)
+					.writeBuffer(8, &materialTableInfo)
 					.build(globalDescriptorSets[i]);
 		}
 	}
 
 	void FirstApp::build()
 	{
+		// every pipeline compiles at the same time, the systems pick them up after the wait
+		LvePipelineBuildQueue buildQueue{lveDevice, jobSystem};
+
+		// bit i of a material variant turns on sceneFeatures[i], the light count is compiled into every variant
+		std::vector<std::string> sceneFeatures{"TEXTURED"};
+		std::vector<SpecializationConstant> sceneConstants{{0, MAX_LIGHT_COUNT}}; // LIGHT_COUNT in shader.frag
+
 		simpleRenderSystem = std::make_unique<SimpleRenderSystem>(
-			lveDevice, lveRenderer.getSwapChainRenderPass(),
-			globalSetLayout->getDescriptorSetLayout(),
-			simpleVert, simpleFrag, SimpleRenderSystem::PipelineType::default_pipeline
+			lveDevice, lveRenderer.getSwapChainRenderPass(), *globalSetLayout,
+			simpleVert, simpleFrag, SimpleRenderSystem::PipelineType::default_pipeline, &buildQueue,
+			sceneFeatures, sceneConstants
+		);
+
+		transparentRenderSystem = std::make_unique<SimpleRenderSystem>(
+			lveDevice, lveRenderer.getSwapChainRenderPass(), *globalSetLayout,
+			simpleVert, simpleFrag, SimpleRenderSystem::PipelineType::transparent_pipeline, &buildQueue,
+			sceneFeatures, sceneConstants
 		);
 
+		// the variants the materials use are built with everything else, rarer ones on first draw
+		simpleRenderSystem->prepareVariants(materialVariants, &buildQueue);
+		transparentRenderSystem->prepareVariants(materialVariants, &buildQueue);
+
 		renderSyncSystem = std::make_unique<RenderSyncSystem>(
-			renderBucket, lveDevice, *globalSetLayout.get());
+			renderBucket, lveDevice, *globalSetLayout.get(), jobSystem, &buildQueue);
+
+		buildQueue.wait();
+		simpleRenderSystem->collectPipeline();
+		transparentRenderSystem->collectPipeline();
+		renderSyncSystem->getPointShadowRenderer().collectPipeline();
 	}
 
-	VkCommandBuffer FirstApp::startFrame()
+	void FirstApp::updateLatencyProfile()
 	{
-		if (VkCommandBuffer commandBuffer = lveRenderer.beginFrame())
+		// F1 low latency, F2 throughput, F3 vsync, F4 capped at 60
+		GLFWwindow *window = lveWindow.getGLFWwindow();
+		LatencyMode current = lveRenderer.getLatencyProfile().mode;
+		if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS && current != LatencyMode::lowLatency)
+			lveRenderer.setLatencyProfile(LveLatencyProfile::lowLatency());
+		else if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS && current != LatencyMode::throughput)
+			lveRenderer.setLatencyProfile(LveLatencyProfile::throughput());
+		else if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS && current != LatencyMode::vsync)
+			lveRenderer.setLatencyProfile(LveLatencyProfile::vsync());
+		else if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS && current != LatencyMode::capped)
+			lveRenderer.setLatencyProfile(LveLatencyProfile::capped());
+	}
+
+	const char *FirstApp::latencyModeName(LatencyMode mode)
+	{
+		switch (mode)
 		{
-			lveRenderer.beginSwapChainRenderPass(commandBuffer);
-			return commandBuffer;
+			case LatencyMode::lowLatency: return "low latency";
+			case LatencyMode::throughput: return "throughput";
+			case LatencyMode::vsync: return "vsync";
+			case LatencyMode::capped: return "capped";
+			default: return "";
 		}
-		else
-			return VK_NULL_HANDLE;
+	}
+
+	VkCommandBuffer FirstApp::startFrame()
+	{
+		// the swap chain pass is begun in render(), shadow passes have to be recorded before it
+		return lveRenderer.beginFrame();
 	}
 
 	void FirstApp::endFrame(VkCommandBuffer &commandBuffer)
@@ -251,7 +618,7 @@ namespace lve {
 		std::vector<std::string> files;
 		files.emplace_back("/home/taha/CLionProjects/untitled4/models/smooth_vase.obj");
 		files.emplace_back("/home/taha/CLionProjects/untitled4/models/cube.obj");
-		renderBucket.createMeshes(files);
+		renderBucket.createMeshes(files, &jobSystem);
 
 		files.clear();
 		files.emplace_back("/home/taha/Pictures/Screenshots/Screenshot from 2025-09-21 14-39-26.png");
@@ -259,6 +626,9 @@ namespace lve {
 
 		for (auto const &f: files)
 			textures.push_back(std::make_unique<VulkanTexture>(lveDevice, f));
+
+		// every mesh and texture copy above goes out in one submit, the first frame already draws them
+		lveDevice.uploads().finishAssets();
 	}
 
 
@@ -305,6 +675,7 @@ namespace lve {
 		init_info.QueueFamily = lveDevice.findPhysicalQueueFamilies().graphicsFamily;
 		init_info.Queue = lveDevice.graphicsQueue();
 		init_info.DescriptorPool = imguiPool;
+		init_info.PipelineCache = lveDevice.pipelineCache();
 		init_info.MinImageCount = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
 		init_info.ImageCount = LveSwapChain::MAX_FRAMES_IN_FLIGHT;
 		init_info.UseDynamicRendering = false; // or true if using KHR_dynamic_rendering
@@ -10,9 +10,16 @@
 #include "lve_frame_info.hpp"
 #include "Texture.h"
 #include "entt.hpp"
+#include "lve_job_system.hpp"
+#include "lve_frame_queue.hpp"
+#include "lve_render_snapshot.hpp"
+#include "lve_shader_watcher.hpp"
 
 // std
+#include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "simple_render_system.hpp"
@@ -28,6 +35,17 @@ namespace lve {
 		int WIDTH = 800;
 		int HEIGHT = 600;
 		uint32_t MAX_OBJECT_COUNT = 32;
+		uint32_t MAX_STATIC_OBJECT_COUNT = 1024;
+		uint32_t MAX_MATERIAL_COUNT = 256;
+		uint32_t MAX_LIGHT_COUNT = 1; // size of the light buffer, the scene shaders loop over this many
+		// simulation on the calling thread, recording and submission on a separate render thread
+		bool threadedRendering = false;
+		// only render when input, scene edits, camera movement or uploads changed something, the loop
+		// blocks on glfw events in between
+		bool idleRendering = false;
+		// development only: rebuilds pipelines in the background when a shader source is saved,
+		// swapped in at the next frame
+		bool hotReloadShaders = false;
 		FirstApp();
 		~FirstApp();
 
@@ -35,14 +53,35 @@ namespace lve {
 		FirstApp &operator=(const FirstApp &) = delete;
 
 		void run();
+		// thread safe, wakes an idle loop and renders the next frames
+		void requestRedraw();
 
 	private:
 		// loop
-		void update(VkCommandBuffer &commandBuffer);
-		void updateShadow();
+		void runThreaded();
+		// polls glfw, or blocks on it while idle, and marks the frame dirty when events came in
+		void pumpEvents(bool justInTimeInput);
+		void markDirty();
+		// whether the simulated frame should be rendered
+		bool consumeRedraw();
+		// simulation side: input, ecs and bucket sort, only writes into the snapshot
+		void simulate(RenderSnapshot &frame);
+		// render side: everything that touches the gpu for one snapshot
+		void submit(RenderSnapshot &frame);
+		void upload(RenderSnapshot &frame);
+		// grows this frame's dynamic and the shared static instance buffers to fit the bucket,
+		// and points this frame's descriptor set at the current ones
+		void ensureInstanceCapacity(const BucketFrame &bucket);
+		// swaps buffer for one that holds count instances, the old one is retired with this frame
+		bool growBuffer(std::unique_ptr<LveBuffer> &buffer, uint32_t count);
+		void writeInstanceDescriptors(int frame);
+		// switches the renderer latency profile from the function keys
+		void updateLatencyProfile();
+		static const char *latencyModeName(LatencyMode mode);
 		VkCommandBuffer startFrame();
-		void render(VkCommandBuffer &commandBuffer);
-		void renderImGui(VkCommandBuffer &commandBuffer);
+		void render(VkCommandBuffer &commandBuffer, RenderSnapshot &frame);
+		void recordScene(VkCommandBuffer commandBuffer);
+		void renderImGui(VkCommandBuffer commandBuffer, ImGuiSnapshot &imGui);
 		void endFrame(VkCommandBuffer &commandBuffer);
 
 		// buid process
@@ -55,24 +94,39 @@ namespace lve {
 		LveWindow lveWindow{WIDTH, HEIGHT, "Vulkan Tutorial"};
 		LveDevice lveDevice{lveWindow};
 		LveRenderer lveRenderer{lveWindow, lveDevice};
+		LveJobSystem jobSystem;
 		std::unique_ptr<SimpleRenderSystem> simpleRenderSystem;
+		std::unique_ptr<SimpleRenderSystem> transparentRenderSystem;
 		std::unique_ptr<LveDescriptorSetLayout> globalSetLayout;
 		std::string simpleVert = "/home/taha/CLionProjects/untitled4/shaders/shader.vert", simpleFrag = "/home/taha/CLionProjects/untitled4/shaders/shader.frag";
 
 		// stuff
 		Camera camera;
 		GlobalUbo ubo;
-		std::unique_ptr<LveBuffer> drawSSBO; // ssbo
-		RenderBucket renderBucket{lveDevice, MAX_OBJECT_COUNT, *drawSSBO};
+		// dynamic partition, one per frame in flight so the cpu never rewrites what an earlier frame still reads
+		std::vector<std::unique_ptr<LveBuffer> > drawSSBOs{LveSwapChain::MAX_FRAMES_IN_FLIGHT};
+		std::vector<std::unique_ptr<LveBuffer> > materialSSBOs{LveSwapChain::MAX_FRAMES_IN_FLIGHT}; // material id per drawSSBOs entry
+		std::unique_ptr<LveBuffer> staticSSBO, staticMaterialSSBO; // device local, for instances that never move
+		std::unique_ptr<LveBuffer> materialTableSSBO; // Material per material id
+		// bumped whenever a static buffer is replaced, each frame's descriptor set catches up on its next upload
+		uint32_t staticBuffersVersion = 0;
+		std::vector<uint32_t> instanceDescriptorVersions = std::vector<uint32_t>(LveSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+		std::vector<uint32_t> materialVariants; // every shader variant some material needs, built at startup
+		RenderBucket renderBucket{lveDevice, MAX_OBJECT_COUNT};
 		std::unique_ptr<RenderSyncSystem> renderSyncSystem;
 
 		// light
-		std::unique_ptr<LveBuffer> pointLightBuffer;
+		// one per frame in flight, rewritten every frame
+		std::vector<std::unique_ptr<LveBuffer> > pointLightBuffers{LveSwapChain::MAX_FRAMES_IN_FLIGHT};
 		VkExtent2D shadowExtent{2024, 2024};
 
 		// objects
 		uint32_t objectCount = 0;
 
+		// double buffered frame state handed from simulation to rendering
+		std::array<RenderSnapshot, 2> snapshots;
+		std::mutex imGuiMutex;
+
 		// textures
 		std::vector<std::unique_ptr<VulkanTexture> > textures;
 
@@ -82,7 +136,18 @@ namespace lve {
 		std::vector<std::unique_ptr<LveBuffer> > uboBuffers{LveSwapChain::MAX_FRAMES_IN_FLIGHT};
 
 		double lastTime = 0, currentTime = 0, lastUpdate1 = 0, deltaTime = 0;
-		float aspect;
+		float aspect = 1.f;
 		int frameIndex = 0;
+
+		// idle mode
+		static constexpr double IDLE_TIMEOUT = 0.5;
+		// frames drawn after the last change, imgui needs a few to settle after input
+		static constexpr uint32_t REDRAW_FRAMES = 3;
+		uint32_t redrawFrames = REDRAW_FRAMES;
+		uint64_t lastEventCount = 0;
+		std::atomic<bool> redrawRequested{false};
+
+		// last, its thread rebuilds pipelines against layouts the systems above own
+		std::unique_ptr<LveShaderWatcher> shaderWatcher;
 	};
 } // namespace lve
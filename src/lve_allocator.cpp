@@ -0,0 +1,569 @@
+#include "lve_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+	static constexpr uint32_t NIL = ~0u;
+	static constexpr uint32_t SL_BITS = 4;
+	static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+	static constexpr uint32_t FL_COUNT = 64;
+	static constexpr VkDeviceSize SMALL_SIZE = 256; // everything below shares the first level
+	static constexpr VkDeviceSize MIN_SPLIT = 64; // smaller leftovers stay attached to the allocation
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// two level segregated fit, first level is the power of two, second level splits that into SL_COUNT classes
+	static void mapping(VkDeviceSize size, uint32_t &fl, uint32_t &sl)
+	{
+		if (size < SMALL_SIZE)
+		{
+			fl = 0;
+			sl = static_cast<uint32_t>(size / (SMALL_SIZE / SL_COUNT));
+			return;
+		}
+		uint32_t log = static_cast<uint32_t>(std::bit_width(size)) - 1;
+		fl = log - static_cast<uint32_t>(std::bit_width(SMALL_SIZE) - 2);
+		sl = static_cast<uint32_t>(size >> (log - SL_BITS)) ^ SL_COUNT;
+	}
+
+	// rounds up to the next class, so every free node in the resulting list is big enough
+	static void mappingSearch(VkDeviceSize size, uint32_t &fl, uint32_t &sl)
+	{
+		if (size < SMALL_SIZE)
+			size += SMALL_SIZE / SL_COUNT - 1;
+		else
+			size += (VkDeviceSize{1} << (std::bit_width(size) - 1 - SL_BITS)) - 1;
+		mapping(size, fl, sl);
+	}
+
+	class LveTlsf {
+	public:
+		explicit LveTlsf(VkDeviceSize size)
+		{
+			for (auto &list: heads)
+				std::fill(std::begin(list), std::end(list), NIL);
+			uint32_t node = newNode();
+			nodes[node].size = size;
+			insertFree(node);
+		}
+
+		// returns the node of the allocation or NIL when nothing fits
+		uint32_t allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset)
+		{
+			// asking for the worst case padding up front means the first node found always fits
+			uint32_t fl, sl;
+			mappingSearch(size + alignment - 1, fl, sl);
+			if (fl >= FL_COUNT) return NIL;
+			uint32_t index = findFree(fl, sl);
+			if (index == NIL) return NIL;
+			removeFree(index);
+
+			VkDeviceSize padding = alignUp(nodes[index].offset, alignment) - nodes[index].offset;
+			if (padding)
+			{
+				// the node before is in use, otherwise the two would have merged, so the padding stays on its own
+				uint32_t front = newNode();
+				nodes[front].offset = nodes[index].offset;
+				nodes[front].size = padding;
+				link(nodes[index].prevPhys, front, index);
+				nodes[index].offset += padding;
+				nodes[index].size -= padding;
+				insertFree(front);
+			}
+
+			if (nodes[index].size - size >= MIN_SPLIT)
+			{
+				uint32_t back = newNode();
+				nodes[back].offset = nodes[index].offset + size;
+				nodes[back].size = nodes[index].size - size;
+				link(index, back, nodes[index].nextPhys);
+				nodes[index].size = size;
+				insertFree(back);
+			}
+
+			offset = nodes[index].offset;
+			return index;
+		}
+
+		void free(uint32_t index)
+		{
+			uint32_t prev = nodes[index].prevPhys;
+			if (prev != NIL && nodes[prev].free)
+			{
+				removeFree(prev);
+				nodes[prev].size += nodes[index].size;
+				unlink(index);
+				index = prev;
+			}
+
+			uint32_t next = nodes[index].nextPhys;
+			if (next != NIL && nodes[next].free)
+			{
+				removeFree(next);
+				nodes[index].size += nodes[next].size;
+				unlink(next);
+			}
+
+			insertFree(index);
+		}
+
+	private:
+		struct Node {
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			uint32_t prevPhys = NIL, nextPhys = NIL; // neighbours by address
+			uint32_t prevFree = NIL, nextFree = NIL; // neighbours in the size class list
+			bool free = false;
+		};
+
+		uint32_t newNode()
+		{
+			if (unusedNodes.empty())
+			{
+				nodes.emplace_back();
+				return static_cast<uint32_t>(nodes.size() - 1);
+			}
+			uint32_t index = unusedNodes.back();
+			unusedNodes.pop_back();
+			nodes[index] = Node{};
+			return index;
+		}
+
+		// puts middle between prev and next in address order
+		void link(uint32_t prev, uint32_t middle, uint32_t next)
+		{
+			nodes[middle].prevPhys = prev;
+			nodes[middle].nextPhys = next;
+			if (prev != NIL) nodes[prev].nextPhys = middle;
+			if (next != NIL) nodes[next].prevPhys = middle;
+		}
+
+		// drops a node that was merged into its neighbour
+		void unlink(uint32_t index)
+		{
+			uint32_t prev = nodes[index].prevPhys, next = nodes[index].nextPhys;
+			if (prev != NIL) nodes[prev].nextPhys = next;
+			if (next != NIL) nodes[next].prevPhys = prev;
+			unusedNodes.push_back(index);
+		}
+
+		uint32_t findFree(uint32_t fl, uint32_t sl) const
+		{
+			uint32_t slMap = slBitmap[fl] & (~0u << sl);
+			if (!slMap)
+			{
+				uint64_t flMap = fl + 1 < FL_COUNT ? flBitmap & (~uint64_t{0} << (fl + 1)) : 0;
+				if (!flMap) return NIL;
+				fl = static_cast<uint32_t>(std::countr_zero(flMap));
+				slMap = slBitmap[fl];
+			}
+			return heads[fl][std::countr_zero(slMap)];
+		}
+
+		void insertFree(uint32_t index)
+		{
+			uint32_t fl, sl;
+			mapping(nodes[index].size, fl, sl);
+			uint32_t head = heads[fl][sl];
+
+			nodes[index].free = true;
+			nodes[index].prevFree = NIL;
+			nodes[index].nextFree = head;
+			if (head != NIL) nodes[head].prevFree = index;
+			heads[fl][sl] = index;
+
+			slBitmap[fl] |= 1u << sl;
+			flBitmap |= uint64_t{1} << fl;
+		}
+
+		void removeFree(uint32_t index)
+		{
+			uint32_t fl, sl;
+			mapping(nodes[index].size, fl, sl);
+			Node &node = nodes[index];
+
+			if (node.prevFree != NIL) nodes[node.prevFree].nextFree = node.nextFree;
+			if (node.nextFree != NIL) nodes[node.nextFree].prevFree = node.prevFree;
+			if (heads[fl][sl] == index)
+			{
+				heads[fl][sl] = node.nextFree;
+				if (node.nextFree == NIL)
+				{
+					slBitmap[fl] &= ~(1u << sl);
+					if (!slBitmap[fl]) flBitmap &= ~(uint64_t{1} << fl);
+				}
+			}
+			node.free = false;
+			node.prevFree = node.nextFree = NIL;
+		}
+
+		std::vector<Node> nodes;
+		std::vector<uint32_t> unusedNodes;
+		uint64_t flBitmap = 0;
+		uint32_t slBitmap[FL_COUNT]{};
+		uint32_t heads[FL_COUNT][SL_COUNT];
+	};
+
+	struct LveMemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		void *mapped = nullptr;
+		uint32_t memoryType = 0;
+		AllocationStrategy strategy = AllocationStrategy::general;
+		bool optimalImage = false;
+
+		std::unique_ptr<LveTlsf> tlsf; // general only
+		VkDeviceSize head = 0; // linear only
+		uint32_t liveCount = 0;
+	};
+
+	LveAllocator::LveAllocator(VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget,
+								VkDeviceSize preferredBlockSize)
+		: physicalDevice{physicalDevice}, device{device}, memoryBudget{memoryBudget},
+		preferredBlockSize{preferredBlockSize}
+	{
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+
+		heapBlockBytes.resize(memoryProperties.memoryHeapCount, 0);
+		heapAllocationBytes.resize(memoryProperties.memoryHeapCount, 0);
+	}
+
+	LveAllocator::~LveAllocator()
+	{
+		for (auto &block: blocks)
+		{
+			assert(block->liveCount == 0 && "allocation outlived the allocator");
+			vkFreeMemory(device, block->memory, nullptr);
+		}
+	}
+
+	void LveAllocator::createBuffer(const VkBufferCreateInfo &bufferInfo, VkMemoryPropertyFlags properties,
+									VkBuffer &buffer, LveAllocation &allocation, AllocationStrategy strategy)
+	{
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to create buffer!");
+
+		VkMemoryDedicatedRequirements dedicated{};
+		dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements.pNext = &dedicated;
+		VkBufferMemoryRequirementsInfo2 info{};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+		info.buffer = buffer;
+		vkGetBufferMemoryRequirements2(device, &info, &requirements);
+		if (dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation)
+			strategy = AllocationStrategy::dedicated;
+
+		{
+			std::lock_guard lock{mutex};
+			allocation = allocateLocked(requirements.memoryRequirements, properties, strategy, false, {buffer, VK_NULL_HANDLE});
+		}
+		vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+	}
+
+	void LveAllocator::createImage(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties,
+									VkImage &image, LveAllocation &allocation, AllocationStrategy strategy)
+	{
+		if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+			throw std::runtime_error("failed to create image!");
+
+		VkMemoryDedicatedRequirements dedicated{};
+		dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		requirements.pNext = &dedicated;
+		VkImageMemoryRequirementsInfo2 info{};
+		info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+		info.image = image;
+		vkGetImageMemoryRequirements2(device, &info, &requirements);
+		if (dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation)
+			strategy = AllocationStrategy::dedicated;
+
+		{
+			std::lock_guard lock{mutex};
+			allocation = allocateLocked(requirements.memoryRequirements, properties, strategy,
+										imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL, {VK_NULL_HANDLE, image});
+		}
+		if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+			throw std::runtime_error("failed to bind image memory!");
+	}
+
+	void LveAllocator::destroyBuffer(VkBuffer buffer, LveAllocation &allocation)
+	{
+		vkDestroyBuffer(device, buffer, nullptr);
+		free(allocation);
+	}
+
+	void LveAllocator::destroyImage(VkImage image, LveAllocation &allocation)
+	{
+		vkDestroyImage(device, image, nullptr);
+		free(allocation);
+	}
+
+	LveAllocation LveAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+										AllocationStrategy strategy, bool optimalImage)
+	{
+		std::lock_guard lock{mutex};
+		return allocateLocked(requirements, properties, strategy, optimalImage, {});
+	}
+
+	void LveAllocator::free(LveAllocation &allocation)
+	{
+		if (!allocation) return;
+		std::lock_guard lock{mutex};
+
+		LveMemoryBlock *block = allocation.block;
+		heapAllocationBytes[memoryProperties.memoryTypes[block->memoryType].heapIndex] -= allocation.size;
+		block->liveCount--;
+
+		switch (block->strategy)
+		{
+			case AllocationStrategy::dedicated:
+				destroyBlock(block);
+				break;
+			case AllocationStrategy::linear:
+				if (block->liveCount == 0) block->head = 0; // everything is gone, start over from the front
+				break;
+			case AllocationStrategy::general:
+				block->tlsf->free(allocation.node);
+				if (block->liveCount == 0)
+				{
+					// keep one empty block around per memory type so a free followed by an allocate doesn't thrash
+					bool spare = std::any_of(blocks.begin(), blocks.end(), [&](const auto &other) {
+						return other.get() != block && other->strategy == block->strategy &&
+								other->memoryType == block->memoryType && other->optimalImage == block->optimalImage;
+					});
+					if (spare) destroyBlock(block);
+				}
+				break;
+		}
+		allocation = {};
+	}
+
+	VkResult LveAllocator::flush(const LveAllocation &allocation, VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (!allocation.mapped ||
+			memoryProperties.memoryTypes[allocation.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+			return VK_SUCCESS;
+		VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+		return vkFlushMappedMemoryRanges(device, 1, &range);
+	}
+
+	VkResult LveAllocator::invalidate(const LveAllocation &allocation, VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (!allocation.mapped ||
+			memoryProperties.memoryTypes[allocation.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+			return VK_SUCCESS;
+		VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+		return vkInvalidateMappedMemoryRanges(device, 1, &range);
+	}
+
+	LveHeapBudget LveAllocator::getBudget(uint32_t heapIndex)
+	{
+		assert(heapIndex < memoryProperties.memoryHeapCount && "heap index out of range");
+		std::lock_guard lock{mutex};
+		return budgetLocked(heapIndex);
+	}
+
+	LveHeapBudget LveAllocator::budgetLocked(uint32_t heapIndex) const
+	{
+		LveHeapBudget budget{};
+		budget.blockBytes = heapBlockBytes[heapIndex];
+		budget.allocationBytes = heapAllocationBytes[heapIndex];
+
+		if (memoryBudget)
+		{
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			VkPhysicalDeviceMemoryProperties2 properties{};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			properties.pNext = &budgetProperties;
+			vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+			budget.usage = budgetProperties.heapUsage[heapIndex];
+			budget.budget = budgetProperties.heapBudget[heapIndex];
+		} else
+		{
+			// without the extension only our own blocks are known, other processes are invisible
+			budget.usage = budget.blockBytes;
+			budget.budget = memoryProperties.memoryHeaps[heapIndex].size * 8 / 10;
+		}
+		return budget;
+	}
+
+	uint32_t LveAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+				return i;
+		}
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+	LveAllocation LveAllocator::allocateLocked(const VkMemoryRequirements &requirements,
+												VkMemoryPropertyFlags properties, AllocationStrategy strategy,
+												bool optimalImage, DedicatedTarget target)
+	{
+		uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+		VkDeviceSize blockSize = blockSizeFor(memoryType);
+		VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+		// anything this big would leave most of a shared block unusable
+		if (strategy == AllocationStrategy::general && requirements.size > blockSize / 2)
+			strategy = AllocationStrategy::dedicated;
+
+		auto place = [&](LveMemoryBlock &block, VkDeviceSize &offset, uint32_t &node) {
+			if (block.strategy == AllocationStrategy::linear)
+			{
+				offset = alignUp(block.head, alignment);
+				if (offset + requirements.size > block.size) return false;
+				block.head = offset + requirements.size;
+				return true;
+			}
+			node = block.tlsf->allocate(requirements.size, alignment, offset);
+			return node != NIL;
+		};
+
+		LveMemoryBlock *block = nullptr;
+		VkDeviceSize offset = 0;
+		uint32_t node = NIL;
+
+		if (strategy == AllocationStrategy::dedicated)
+		{
+			block = createBlock(memoryType, requirements.size, strategy, optimalImage, target);
+		} else
+		{
+			for (auto &candidate: blocks)
+			{
+				if (candidate->strategy != strategy || candidate->memoryType != memoryType ||
+					candidate->optimalImage != optimalImage)
+					continue;
+				if (place(*candidate, offset, node))
+				{
+					block = candidate.get();
+					break;
+				}
+			}
+
+			// new block, halved while the budget or the driver says no but never below what this request needs.
+			// the tlsf search rounds up to the next size class, so a fresh block needs a bit of headroom
+			VkDeviceSize needed = requirements.size + alignment - 1;
+			needed += needed / 8 + SMALL_SIZE;
+			LveHeapBudget heap{};
+			if (!block && memoryBudget)
+				heap = budgetLocked(memoryProperties.memoryTypes[memoryType].heapIndex);
+			for (VkDeviceSize size = std::max(blockSize, needed); !block; size /= 2)
+			{
+				size = std::max(size, needed);
+				bool overBudget = memoryBudget && heap.usage + size > heap.budget;
+				if (!overBudget || size == needed)
+					block = createBlock(memoryType, size, strategy, optimalImage, {});
+				if (block && !place(*block, offset, node))
+					throw std::runtime_error("failed to place allocation in a new memory block!");
+				if (size == needed) break;
+			}
+		}
+
+		if (!block)
+			throw std::runtime_error("failed to allocate gpu memory!");
+
+		block->liveCount++;
+		heapAllocationBytes[memoryProperties.memoryTypes[memoryType].heapIndex] += requirements.size;
+
+		LveAllocation allocation{};
+		allocation.memory = block->memory;
+		allocation.offset = offset;
+		allocation.size = requirements.size;
+		allocation.mapped = block->mapped ? static_cast<char *>(block->mapped) + offset : nullptr;
+		allocation.memoryType = memoryType;
+		allocation.block = block;
+		allocation.node = node;
+		return allocation;
+	}
+
+	LveMemoryBlock *LveAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, AllocationStrategy strategy,
+											bool optimalImage, DedicatedTarget target)
+	{
+		VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+		dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedInfo.buffer = target.buffer;
+		dedicatedInfo.image = target.image;
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryType;
+		if (target.buffer || target.image) allocInfo.pNext = &dedicatedInfo;
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+			return nullptr;
+
+		auto block = std::make_unique<LveMemoryBlock>();
+		block->memory = memory;
+		block->size = size;
+		block->memoryType = memoryType;
+		block->strategy = strategy;
+		block->optimalImage = optimalImage;
+		if (strategy == AllocationStrategy::general)
+			block->tlsf = std::make_unique<LveTlsf>(size);
+
+		if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS)
+			{
+				vkFreeMemory(device, memory, nullptr);
+				throw std::runtime_error("failed to map memory block!");
+			}
+		}
+
+		heapBlockBytes[memoryProperties.memoryTypes[memoryType].heapIndex] += size;
+		blocks.push_back(std::move(block));
+		return blocks.back().get();
+	}
+
+	void LveAllocator::destroyBlock(LveMemoryBlock *block)
+	{
+		heapBlockBytes[memoryProperties.memoryTypes[block->memoryType].heapIndex] -= block->size;
+		vkFreeMemory(device, block->memory, nullptr); // implicitly unmaps
+
+		auto it = std::find_if(blocks.begin(), blocks.end(), [&](const auto &b) { return b.get() == block; });
+		*it = std::move(blocks.back());
+		blocks.pop_back();
+	}
+
+	VkMappedMemoryRange LveAllocator::mappedRange(const LveAllocation &allocation, VkDeviceSize size,
+												VkDeviceSize offset) const
+	{
+		// the range has to be atom aligned, which can spill into a neighbour. flushing that is harmless
+		VkDeviceSize begin = allocation.offset + offset;
+		VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+		begin = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+		end = std::min(alignUp(end, nonCoherentAtomSize), allocation.block->size);
+
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = allocation.memory;
+		range.offset = begin;
+		range.size = end - begin;
+		return range;
+	}
+
+	VkDeviceSize LveAllocator::blockSizeFor(uint32_t memoryType) const
+	{
+		// small heaps (like the host visible window into vram) get smaller blocks
+		VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+		return std::min(preferredBlockSize, heapSize / 8);
+	}
+} // namespace lve
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lve {
+	enum class AllocationStrategy : uint8_t {
+		general, // tlsf placement inside a shared block
+		linear, // bump allocated, the block rewinds once everything in it is freed. for short lived staging data
+		dedicated, // own vkAllocateMemory, for big resources or when the driver asks for it
+	};
+
+	struct LveMemoryBlock;
+
+	struct LveAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void *mapped = nullptr; // persistently mapped pointer at offset, null for memory the host can't see
+		uint32_t memoryType = ~0u;
+
+		LveMemoryBlock *block = nullptr;
+		uint32_t node = ~0u; // tlsf node inside block, unused for linear and dedicated
+
+		explicit operator bool() const { return memory != VK_NULL_HANDLE; }
+	};
+
+	struct LveHeapBudget {
+		VkDeviceSize blockBytes = 0; // taken from vulkan by this allocator
+		VkDeviceSize allocationBytes = 0; // handed out to resources, the rest of blockBytes is free space
+		VkDeviceSize usage = 0; // whole process, from VK_EXT_memory_budget when available
+		VkDeviceSize budget = 0; // what the process can use before the driver starts evicting
+	};
+
+	// sub allocates buffers and images out of big VkDeviceMemory blocks, one set of blocks per memory type.
+	// buffers and optimal images never share a block so bufferImageGranularity can be ignored.
+	// host visible blocks stay mapped for their whole lifetime. all calls are thread safe
+	class LveAllocator {
+	public:
+		LveAllocator(VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget,
+					VkDeviceSize preferredBlockSize = 64ull << 20);
+		~LveAllocator();
+
+		LveAllocator(const LveAllocator &) = delete;
+		LveAllocator &operator=(const LveAllocator &) = delete;
+
+		void createBuffer(const VkBufferCreateInfo &bufferInfo, VkMemoryPropertyFlags properties, VkBuffer &buffer,
+						LveAllocation &allocation, AllocationStrategy strategy = AllocationStrategy::general);
+		void createImage(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image,
+						LveAllocation &allocation, AllocationStrategy strategy = AllocationStrategy::general);
+		void destroyBuffer(VkBuffer buffer, LveAllocation &allocation);
+		void destroyImage(VkImage image, LveAllocation &allocation);
+
+		// raw memory for resources created elsewhere, bind it at allocation.offset
+		LveAllocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+								AllocationStrategy strategy = AllocationStrategy::general, bool optimalImage = false);
+		void free(LveAllocation &allocation);
+
+		// offset and size are relative to the allocation, no-ops on coherent memory
+		VkResult flush(const LveAllocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult invalidate(const LveAllocation &allocation, VkDeviceSize size = VK_WHOLE_SIZE,
+							VkDeviceSize offset = 0);
+
+		LveHeapBudget getBudget(uint32_t heapIndex);
+		uint32_t getHeapCount() const { return memoryProperties.memoryHeapCount; }
+
+	private:
+		struct DedicatedTarget {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkImage image = VK_NULL_HANDLE;
+		};
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+		LveAllocation allocateLocked(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+									AllocationStrategy strategy, bool optimalImage, DedicatedTarget target);
+		LveMemoryBlock *createBlock(uint32_t memoryType, VkDeviceSize size, AllocationStrategy strategy,
+									bool optimalImage, DedicatedTarget target);
+		void destroyBlock(LveMemoryBlock *block);
+		LveHeapBudget budgetLocked(uint32_t heapIndex) const;
+		VkMappedMemoryRange mappedRange(const LveAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) const;
+		VkDeviceSize blockSizeFor(uint32_t memoryType) const;
+
+		VkPhysicalDevice physicalDevice;
+		VkDevice device;
+		bool memoryBudget;
+		VkDeviceSize preferredBlockSize;
+		VkDeviceSize nonCoherentAtomSize;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+
+		std::mutex mutex;
+		std::vector<std::unique_ptr<LveMemoryBlock> > blocks;
+		std::vector<VkDeviceSize> heapBlockBytes, heapAllocationBytes;
+	};
+} // namespace lve
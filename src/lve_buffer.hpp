@@ -11,7 +11,8 @@ namespace lve {
 			uint32_t instanceCount,
 			VkBufferUsageFlags usageFlags,
 			VkMemoryPropertyFlags memoryPropertyFlags,
-			VkDeviceSize minOffsetAlignment = 1);
+			VkDeviceSize minOffsetAlignment = 1,
+			AllocationStrategy strategy = AllocationStrategy::general);
 
 		~LveBuffer();
 
@@ -54,7 +55,7 @@ namespace lve {
 		LveDevice &lveDevice;
 		void *mapped = nullptr;
 		VkBuffer buffer = VK_NULL_HANDLE;
-		VkDeviceMemory memory = VK_NULL_HANDLE;
+		LveAllocation allocation{};
 
 		VkDeviceSize bufferSize;
 		uint32_t instanceCount;
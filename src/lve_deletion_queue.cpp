@@ -0,0 +1,66 @@
+#include "lve_deletion_queue.hpp"
+
+// std
+#include <algorithm>
+#include <vector>
+
+namespace lve {
+	void LveDeletionQueue::retire(std::function<void()> destroy)
+	{
+		std::lock_guard lock{mutex};
+		pushLocked(retireValue, std::move(destroy));
+	}
+
+	void LveDeletionQueue::retire(uint64_t value, std::function<void()> destroy)
+	{
+		std::lock_guard lock{mutex};
+		pushLocked(value, std::move(destroy));
+	}
+
+	void LveDeletionQueue::setRetireValue(uint64_t value)
+	{
+		std::lock_guard lock{mutex};
+		retireValue = std::max(retireValue, value);
+	}
+
+	uint64_t LveDeletionQueue::getRetireValue()
+	{
+		std::lock_guard lock{mutex};
+		return retireValue;
+	}
+
+	void LveDeletionQueue::collect(uint64_t completedValue)
+	{
+		// destroy callbacks run outside the lock, they may retire something themselves
+		std::vector<std::function<void()> > ready;
+		{
+			std::lock_guard lock{mutex};
+			while (!entries.empty() && entries.front().value <= completedValue)
+			{
+				ready.push_back(std::move(entries.front().destroy));
+				entries.pop_front();
+			}
+		}
+		for (auto &destroy: ready)
+			destroy();
+	}
+
+	void LveDeletionQueue::flush()
+	{
+		while (size() > 0)
+			collect(UINT64_MAX);
+	}
+
+	void LveDeletionQueue::pushLocked(uint64_t value, std::function<void()> destroy)
+	{
+		// keeps the queue sorted, waiting a little longer than asked is always fine
+		if (!entries.empty()) value = std::max(value, entries.back().value);
+		entries.push_back({value, std::move(destroy)});
+	}
+
+	size_t LveDeletionQueue::size()
+	{
+		std::lock_guard lock{mutex};
+		return entries.size();
+	}
+} // namespace lve
@@ -0,0 +1,50 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace lve {
+	// destroys gpu objects once the frame timeline has passed the value they were retired at, so buffers,
+	// images and descriptor sets can go away mid-run without idling the device.
+	// the renderer moves the retire value forward with every submitted frame and collects at frame start.
+	// retire() is thread safe
+	class LveDeletionQueue {
+	public:
+		LveDeletionQueue() = default;
+		~LveDeletionQueue() { flush(); }
+
+		LveDeletionQueue(const LveDeletionQueue &) = delete;
+		LveDeletionQueue &operator=(const LveDeletionQueue &) = delete;
+
+		// destroy runs once the frame that is being recorded right now has finished on the gpu
+		void retire(std::function<void()> destroy);
+		// for work that is tracked by a later value than the current frame
+		void retire(uint64_t value, std::function<void()> destroy);
+
+		// frame timeline value the next retired objects wait for
+		void setRetireValue(uint64_t value);
+		uint64_t getRetireValue();
+
+		// runs everything the gpu is done with
+		void collect(uint64_t completedValue);
+		// runs everything, only after the device went idle
+		void flush();
+		size_t size();
+
+	private:
+		struct Entry {
+			uint64_t value;
+			std::function<void()> destroy;
+		};
+
+		void pushLocked(uint64_t value, std::function<void()> destroy);
+
+		std::mutex mutex;
+		std::deque<Entry> entries; // sorted by value
+		// 1 is the first frame, it finishes after everything submitted before it
+		uint64_t retireValue = 1;
+	};
+} // namespace lve
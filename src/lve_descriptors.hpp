@@ -39,6 +39,7 @@ namespace lve {
 		LveDescriptorSetLayout &operator=(const LveDescriptorSetLayout &) = delete;
 
 		VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+		const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> &getBindings() const { return bindings; }
 
 	private:
 		LveDevice &lveDevice;
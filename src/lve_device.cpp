@@ -1,7 +1,12 @@
 #include "lve_device.hpp"
+#include "lve_pipeline_library.hpp"
+#include "lve_shader_cache.hpp"
+#include "lve_upload_manager.hpp"
 
 // std headers
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -54,9 +59,26 @@ LveDevice::LveDevice(LveWindow &window) : window{window} {
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  allocator_ = std::make_unique<LveAllocator>(physicalDevice, device_, memoryBudgetSupported);
+  uploads_ = std::make_unique<LveUploadManager>(*this);
+  shaderCache_ = std::make_unique<LveShaderCache>();
+  createPipelineCache();
+  pipelineLibrary_ = std::make_unique<LvePipelineLibrary>(*this);
 }
 
 LveDevice::~LveDevice() {
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
+
+  // retired objects may still hold allocations and upload ring space
+  vkDeviceWaitIdle(device_);
+  deletionQueue_.flush();
+  pipelineLibrary_.reset();
+  uploads_.reset();
+  allocator_.reset();
+  if (transferCommandPool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device_, transferCommandPool, nullptr);
+  }
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -140,6 +162,7 @@ void LveDevice::createLogicalDevice() {
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+    if (indices.transferFamilyHasValue) uniqueQueueFamilies.insert(indices.transferFamily);
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -155,6 +178,7 @@ void LveDevice::createLogicalDevice() {
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.multiDrawIndirect = VK_TRUE;
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;  // draws start at their partition offset
     deviceFeatures.depthClamp = VK_TRUE;
 
     // Vulkan 1.2 features (includes descriptor indexing)
@@ -165,6 +189,7 @@ void LveDevice::createLogicalDevice() {
     deviceFeatures12.descriptorBindingVariableDescriptorCount = VK_TRUE;
     deviceFeatures12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
     deviceFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    deviceFeatures12.timelineSemaphore = VK_TRUE;
 
     // Vulkan 1.1 features
     VkPhysicalDeviceVulkan11Features deviceFeatures11{};
@@ -172,14 +197,27 @@ void LveDevice::createLogicalDevice() {
     deviceFeatures11.shaderDrawParameters = VK_TRUE;
     deviceFeatures11.pNext = &deviceFeatures12;
 
+    // optional, lets the allocator see what the whole process uses per heap
+    std::vector<const char *> extensions = deviceExtensions;
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    for (const auto &extension : availableExtensions) {
+        if (std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            memoryBudgetSupported = true;
+        }
+    }
+
     // Logical device create info
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
     createInfo.pNext = &deviceFeatures11;  // chain 1.1 -> 1.2
 
     if (enableValidationLayers) {
@@ -195,6 +233,9 @@ void LveDevice::createLogicalDevice() {
 
     vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+    if (indices.transferFamilyHasValue) {
+        vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+    }
 }
 
 
@@ -210,6 +251,117 @@ void LveDevice::createCommandPool() {
   if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+
+  if (queueFamilyIndices.transferFamilyHasValue) {
+    poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily;
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create transfer command pool!");
+    }
+  }
+}
+
+// prefix of the pipeline cache file, the driver blob follows. the vulkan header inside the blob only
+// covers vendor, device and cache uuid, the driver version has to be checked separately
+struct PipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t fileVersion;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint8_t uuid[VK_UUID_SIZE];
+  uint64_t dataSize;
+  double coldCreationMs;
+};
+static constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x4350564c;  // "LVPC"
+static constexpr uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+void LveDevice::createPipelineCache() {
+  std::vector<char> data;
+  std::ifstream file(pipelineCachePath, std::ios::binary);
+  PipelineCacheFileHeader header{};
+  if (file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+    bool valid = header.magic == PIPELINE_CACHE_MAGIC &&
+                 header.fileVersion == PIPELINE_CACHE_FILE_VERSION &&
+                 header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+                 header.driverVersion == properties.driverVersion &&
+                 std::memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+    if (valid) {
+      data.resize(header.dataSize);
+      valid = static_cast<bool>(file.read(data.data(), static_cast<std::streamsize>(data.size())));
+    }
+
+    // the driver checks its own header too, but an empty cache beats a crash in a broken driver
+    VkPipelineCacheHeaderVersionOne blobHeader{};
+    if (valid && data.size() >= sizeof(blobHeader)) {
+      std::memcpy(&blobHeader, data.data(), sizeof(blobHeader));
+      valid = blobHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+              blobHeader.vendorID == properties.vendorID &&
+              blobHeader.deviceID == properties.deviceID &&
+              std::memcmp(blobHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    } else {
+      valid = false;
+    }
+
+    coldPipelineCreationMs = header.magic == PIPELINE_CACHE_MAGIC ? header.coldCreationMs : 0;
+    if (!valid) {
+      std::cout << "pipeline cache: " << pipelineCachePath << " is stale, starting empty" << std::endl;
+      data.clear();
+    }
+  }
+  pipelineCacheWarm = !data.empty();
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+void LveDevice::savePipelineCache() {
+  double creationMs = static_cast<double>(pipelineCreationTime.load()) / 1e6;
+  if (!pipelineCacheWarm) {
+    coldPipelineCreationMs = creationMs;
+    std::cout << "pipeline cache: cold start, pipeline creation took " << creationMs << " ms" << std::endl;
+  } else if (coldPipelineCreationMs > 0) {
+    std::cout << "pipeline cache: pipeline creation took " << creationMs << " ms, "
+              << coldPipelineCreationMs - creationMs << " ms saved against a cold start" << std::endl;
+  }
+
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr) != VK_SUCCESS || size == 0) return;
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data()) != VK_SUCCESS) return;
+  data.resize(size);
+
+  PipelineCacheFileHeader header{};
+  header.magic = PIPELINE_CACHE_MAGIC;
+  header.fileVersion = PIPELINE_CACHE_FILE_VERSION;
+  header.vendorID = properties.vendorID;
+  header.deviceID = properties.deviceID;
+  header.driverVersion = properties.driverVersion;
+  std::memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  header.dataSize = data.size();
+  header.coldCreationMs = coldPipelineCreationMs;
+
+  // written beside the old file and renamed, a crash mid write never leaves a torn cache
+  std::error_code error;
+  std::filesystem::path path = pipelineCachePath;
+  std::filesystem::create_directories(path.parent_path(), error);
+  std::filesystem::path temp = path;
+  temp += ".tmp";
+  {
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      std::cerr << "pipeline cache: failed to write " << temp << std::endl;
+      return;
+    }
+  }
+  std::filesystem::rename(temp, path, error);
 }
 
 void LveDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -362,6 +514,20 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
     i++;
   }
 
+  // a family without graphics and compute is a dedicated copy engine, prefer one of those
+  i = 0;
+  for (const auto &queueFamily : queueFamilies) {
+    bool transfer = queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT;
+    bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+    bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+    if (transfer && !graphics && (!compute || !indices.transferFamilyHasValue)) {
+      indices.transferFamily = i;
+      indices.transferFamilyHasValue = true;
+      if (!compute) break;
+    }
+    i++;
+  }
+
   return indices;
 }
 
@@ -425,30 +591,15 @@ void LveDevice::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+    LveAllocation &allocation,
+    AllocationStrategy strategy) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
   bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-  if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create vertex buffer!");
-  }
-
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
-  }
-
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+  allocator_->createBuffer(bufferInfo, properties, buffer, allocation, strategy);
 }
 
 VkCommandBuffer LveDevice::beginSingleTimeCommands() {
@@ -526,26 +677,9 @@ void LveDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
-  if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create image!");
-  }
-
-  VkMemoryRequirements memRequirements;
-  vkGetImageMemoryRequirements(device_, image, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
-
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to bind image memory!");
-  }
+    LveAllocation &allocation,
+    AllocationStrategy strategy) {
+  allocator_->createImage(imageInfo, properties, image, allocation, strategy);
 }
 
 }  // namespace lve
\ No newline at end of file
@@ -1,12 +1,21 @@
 #pragma once
 
+#include "lve_allocator.hpp"
+#include "lve_deletion_queue.hpp"
 #include "lve_window.hpp"
 
 // std lib headers
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace lve {
+	class LveUploadManager;
+	class LveShaderCache;
+	class LvePipelineLibrary;
+
 	struct SwapChainSupportDetails {
 		VkSurfaceCapabilitiesKHR capabilities;
 		std::vector<VkSurfaceFormatKHR> formats;
@@ -16,8 +25,10 @@ namespace lve {
 	struct QueueFamilyIndices {
 		uint32_t graphicsFamily;
 		uint32_t presentFamily;
+		uint32_t transferFamily; // transfer only family, usually backed by a copy engine
 		bool graphicsFamilyHasValue = false;
 		bool presentFamilyHasValue = false;
+		bool transferFamilyHasValue = false;
 		bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 	};
 
@@ -47,8 +58,23 @@ namespace lve {
 		VkSurfaceKHR surface() { return surface_; }
 		VkQueue graphicsQueue() { return graphicsQueue_; }
 		VkQueue presentQueue() { return presentQueue_; }
+		// VK_NULL_HANDLE without a dedicated transfer family, uploads then stay on the graphics queue
+		VkQueue transferQueue() { return transferQueue_; }
+		VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+		bool hasDedicatedTransferQueue() const { return transferQueue_ != VK_NULL_HANDLE; }
 		VkInstance getInstance() { return instance; }
 		VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
+		LveAllocator &allocator() { return *allocator_; }
+		LveUploadManager &uploads() { return *uploads_; }
+		// objects that frames in flight may still use go through here instead of being destroyed directly
+		LveDeletionQueue &deletionQueue() { return deletionQueue_; }
+		LveShaderCache &shaderCache() { return *shaderCache_; }
+		// one pipeline per distinct pipeline state, shared by every system that asks for it
+		LvePipelineLibrary &pipelineLibrary() { return *pipelineLibrary_; }
+		// loaded from disk at startup and saved at shutdown, pass it to every pipeline creation
+		VkPipelineCache pipelineCache() { return pipelineCache_; }
+		// pipeline creation time spent this run, the saving is reported at shutdown
+		void addPipelineCreationTime(std::chrono::nanoseconds time) { pipelineCreationTime += time.count(); }
 
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 
@@ -65,7 +91,8 @@ namespace lve {
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags properties,
 			VkBuffer &buffer,
-			VkDeviceMemory &bufferMemory);
+			LveAllocation &allocation,
+			AllocationStrategy strategy = AllocationStrategy::general);
 
 		VkCommandBuffer beginSingleTimeCommands();
 
@@ -80,7 +107,8 @@ namespace lve {
 			const VkImageCreateInfo &imageInfo,
 			VkMemoryPropertyFlags properties,
 			VkImage &image,
-			VkDeviceMemory &imageMemory);
+			LveAllocation &allocation,
+			AllocationStrategy strategy = AllocationStrategy::general);
 
 		VkPhysicalDeviceProperties properties;
 
@@ -105,6 +133,10 @@ namespace lve {
 
 		void createCommandPool();
 
+		void createPipelineCache();
+
+		void savePipelineCache();
+
 		// helper functions
 		bool isDeviceSuitable(VkPhysicalDevice device);
 
@@ -132,6 +164,21 @@ namespace lve {
 		VkSurfaceKHR surface_;
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
+		VkQueue transferQueue_ = VK_NULL_HANDLE;
+		VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+		std::unique_ptr<LveAllocator> allocator_;
+		std::unique_ptr<LveUploadManager> uploads_; // after allocator_, its ring is allocated from it
+		bool memoryBudgetSupported = false;
+		LveDeletionQueue deletionQueue_;
+		std::unique_ptr<LveShaderCache> shaderCache_;
+		std::unique_ptr<LvePipelineLibrary> pipelineLibrary_;
+
+		VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+		std::string pipelineCachePath = "cache/pipeline_cache.bin";
+		bool pipelineCacheWarm = false;
+		// creation time of the last run that started without usable cache data, 0 if never measured
+		double coldPipelineCreationMs = 0;
+		std::atomic<int64_t> pipelineCreationTime{0}; // ns
 
 		const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
 		const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -12,6 +12,9 @@ namespace lve {
 
 	LveFrameBuffer::~LveFrameBuffer()
 	{
+		for (size_t i = 0; i < images.size(); i++)
+			device.allocator().destroyImage(images[i], allocations[i]);
+
 		// Destroy render pass
 		if (renderPass != VK_NULL_HANDLE)
 		{
@@ -126,26 +129,10 @@ namespace lve {
 			imageInfo.usage = usage;
 
 			VkImage image;
-			if (vkCreateImage(device.device(), &imageInfo, nullptr, &image) != VK_SUCCESS)
-			{
-				throw std::runtime_error("failed to create framebuffer image!");
-			}
-
-			// Allocate memory (simplified, use VMA in production)
-			VkMemoryRequirements memRequirements;
-			vkGetImageMemoryRequirements(device.device(), image, &memRequirements);
-			VkMemoryAllocateInfo allocInfo{};
-			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			allocInfo.allocationSize = memRequirements.size;
-			allocInfo.memoryTypeIndex = device.findMemoryType(memRequirements.memoryTypeBits,
-															VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-			VkDeviceMemory imageMemory;
-			if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-			{
-				throw std::runtime_error("failed to allocate framebuffer image memory!");
-			}
-			vkBindImageMemory(device.device(), image, imageMemory, 0);
+			LveAllocation allocation{};
+			device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, allocation);
+			images.push_back(image);
+			allocations.push_back(allocation);
 
 			// (2) Create image view
 			VkImageViewCreateInfo viewInfo{};
@@ -38,6 +38,7 @@ namespace lve {
 		ConstructionMode createInfo;
 		std::vector<VkImageView> imageViews;
 		std::vector<VkImage> images;
+		std::vector<LveAllocation> allocations; // parallel to images
 		VkExtent2D extent;
 		std::vector<VkFormat> formats;
 		std::vector<VkImageUsageFlags> usages;
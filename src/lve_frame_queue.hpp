@@ -0,0 +1,63 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace lve {
+	// bounded blocking queue used to hand frames between the simulation and render thread
+	template<typename T>
+	class LveFrameQueue {
+	public:
+		explicit LveFrameQueue(size_t capacity) : capacity{capacity}
+		{
+		}
+
+		LveFrameQueue(const LveFrameQueue &) = delete;
+		LveFrameQueue &operator=(const LveFrameQueue &) = delete;
+
+		// blocks while full, returns false once the queue is closed
+		bool push(T item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+			if (closed) return false;
+
+			items.push_back(std::move(item));
+			notEmpty.notify_one();
+			return true;
+		}
+
+		// blocks while empty, returns false once the queue is closed and drained
+		bool pop(T &item)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+			if (items.empty()) return false;
+
+			item = std::move(items.front());
+			items.pop_front();
+			notFull.notify_one();
+			return true;
+		}
+
+		void close()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				closed = true;
+			}
+			notFull.notify_all();
+			notEmpty.notify_all();
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable notFull, notEmpty;
+		std::deque<T> items;
+		size_t capacity;
+		bool closed = false;
+	};
+} // namespace lve
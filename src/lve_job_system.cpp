@@ -0,0 +1,237 @@
+#include "lve_job_system.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+namespace lve {
+	namespace {
+		thread_local const LveJobSystem *currentSystem = nullptr;
+		thread_local uint32_t currentThreadIndex = ~0u;
+	}
+
+	LveJobSystem::LveJobSystem(uint32_t workerCount)
+	{
+		if (workerCount == 0)
+		{
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		// queue 0 belongs to the thread that created the system
+		queues.reserve(workerCount + 1);
+		for (uint32_t i = 0; i < workerCount + 1; i++)
+			queues.push_back(std::make_unique<WorkQueue>());
+
+		currentSystem = this;
+		currentThreadIndex = 0;
+
+		workers.reserve(workerCount);
+		for (uint32_t i = 1; i <= workerCount; i++)
+			workers.emplace_back(&LveJobSystem::workerLoop, this, i);
+	}
+
+	LveJobSystem::~LveJobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			running.store(false, std::memory_order_release);
+		}
+		sleepCondition.notify_all();
+
+		for (auto &worker: workers)
+			worker.join();
+
+		if (currentSystem == this)
+		{
+			currentSystem = nullptr;
+			currentThreadIndex = ~0u;
+		}
+	}
+
+	uint32_t LveJobSystem::getThreadIndex() const
+	{
+		return currentSystem == this ? currentThreadIndex : ~0u;
+	}
+
+	void LveJobSystem::run(Job job, JobCounter *counter)
+	{
+		if (counter)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+		push(Task{std::move(job), counter});
+	}
+
+	void LveJobSystem::runAfter(JobCounter &dependency, Job job, JobCounter *counter)
+	{
+		if (counter)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+		{
+			// finish() takes the same lock before draining, so the job is either stored or run now
+			std::lock_guard<std::mutex> lock(dependency.continuationMutex);
+			if (!dependency.isDone())
+			{
+				dependency.continuations.emplace_back([this, job = std::move(job), counter]() mutable {
+					push(Task{std::move(job), counter});
+				});
+				return;
+			}
+		}
+
+		push(Task{std::move(job), counter});
+	}
+
+	void LveJobSystem::wait(JobCounter &counter)
+	{
+		uint32_t threadIndex = getThreadIndex();
+		while (!counter.isDone())
+		{
+			if (!tryRunOne(threadIndex))
+				std::this_thread::yield();
+		}
+
+		// the last finisher still holds this lock while releasing continuations,
+		// take it once so the counter can safely go out of scope after we return
+		std::lock_guard<std::mutex> lock(counter.continuationMutex);
+	}
+
+	void LveJobSystem::parallelFor(uint32_t count, uint32_t grainSize, const RangeJob &job)
+	{
+		if (count == 0) return;
+		grainSize = std::max(grainSize, 1u);
+
+		// not worth waking anyone for a single chunk
+		if (count <= grainSize || workers.empty())
+		{
+			job(0, count);
+			return;
+		}
+
+		JobCounter counter;
+		for (uint32_t begin = grainSize; begin < count; begin += grainSize)
+		{
+			uint32_t end = std::min(begin + grainSize, count);
+			run([&job, begin, end]() { job(begin, end); }, &counter);
+		}
+
+		// first chunk runs on the calling thread
+		job(0, grainSize);
+		wait(counter);
+	}
+
+	void LveJobSystem::beginFrame()
+	{
+		assert(frameCounter.isDone() && "beginFrame called while the previous frame still has jobs");
+	}
+
+	void LveJobSystem::endFrame()
+	{
+		wait(frameCounter);
+	}
+
+	void LveJobSystem::push(Task task)
+	{
+		uint32_t threadIndex = getThreadIndex();
+		// outside threads hand their work to the owning thread's queue
+		WorkQueue &queue = *queues[threadIndex < queues.size() ? threadIndex : 0];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back(std::move(task));
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			queuedTasks.fetch_add(1, std::memory_order_release);
+		}
+		sleepCondition.notify_one();
+	}
+
+	bool LveJobSystem::tryPop(uint32_t threadIndex, Task &task)
+	{
+		if (threadIndex >= queues.size()) return false;
+
+		WorkQueue &queue = *queues[threadIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) return false;
+
+		task = std::move(queue.tasks.back());
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool LveJobSystem::trySteal(uint32_t threadIndex, Task &task)
+	{
+		uint32_t queueCount = static_cast<uint32_t>(queues.size());
+		uint32_t start = threadIndex < queueCount ? threadIndex + 1 : 0;
+
+		for (uint32_t i = 0; i < queueCount; i++)
+		{
+			uint32_t victim = (start + i) % queueCount;
+			if (victim == threadIndex) continue;
+
+			WorkQueue &queue = *queues[victim];
+			std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+			if (!lock.owns_lock() || queue.tasks.empty()) continue;
+
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+	bool LveJobSystem::tryRunOne(uint32_t threadIndex)
+	{
+		Task task;
+		if (!tryPop(threadIndex, task) && !trySteal(threadIndex, task))
+			return false;
+
+		queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+		execute(task);
+		return true;
+	}
+
+	void LveJobSystem::execute(Task &task)
+	{
+		task.job();
+		finish(task.counter);
+	}
+
+	void LveJobSystem::finish(JobCounter *counter)
+	{
+		if (!counter) return;
+
+		std::vector<std::function<void()>> ready;
+		{
+			std::lock_guard<std::mutex> lock(counter->continuationMutex);
+			if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			ready.swap(counter->continuations);
+		}
+
+		for (auto &continuation: ready)
+			continuation();
+	}
+
+	void LveJobSystem::workerLoop(uint32_t threadIndex)
+	{
+		currentSystem = this;
+		currentThreadIndex = threadIndex;
+
+		while (true)
+		{
+			if (tryRunOne(threadIndex))
+				continue;
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepCondition.wait(lock, [this]() {
+				return !running.load(std::memory_order_acquire) ||
+						queuedTasks.load(std::memory_order_acquire) > 0;
+			});
+
+			if (!running.load(std::memory_order_acquire) && queuedTasks.load(std::memory_order_acquire) == 0)
+				return;
+		}
+	}
+} // namespace lve
@@ -0,0 +1,98 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lve {
+	class LveJobSystem;
+
+	// counts jobs that still have to finish, continuations run once it hits zero
+	class JobCounter {
+	public:
+		JobCounter() = default;
+
+		JobCounter(const JobCounter &) = delete;
+		JobCounter &operator=(const JobCounter &) = delete;
+
+		bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+		uint32_t getPending() const { return pending.load(std::memory_order_acquire); }
+
+	private:
+		friend class LveJobSystem;
+
+		std::atomic<uint32_t> pending{0};
+		std::mutex continuationMutex;
+		std::vector<std::function<void()>> continuations;
+	};
+
+	class LveJobSystem {
+	public:
+		using Job = std::function<void()>;
+		using RangeJob = std::function<void(uint32_t begin, uint32_t end)>;
+
+		// workerCount 0 picks hardware_concurrency - 1, the calling thread is always thread 0
+		explicit LveJobSystem(uint32_t workerCount = 0);
+		~LveJobSystem();
+
+		LveJobSystem(const LveJobSystem &) = delete;
+		LveJobSystem &operator=(const LveJobSystem &) = delete;
+
+		void run(Job job, JobCounter *counter = nullptr);
+		// queues job once dependency reaches zero, runs right away if it already has
+		void runAfter(JobCounter &dependency, Job job, JobCounter *counter = nullptr);
+		// helps executing jobs until the counter reaches zero
+		void wait(JobCounter &counter);
+
+		// splits [0, count) into chunks of grainSize and blocks until all chunks are done
+		void parallelFor(uint32_t count, uint32_t grainSize, const RangeJob &job);
+
+		// frame scoped jobs: everything pushed with runFrame is done by endFrame
+		void beginFrame();
+		void runFrame(Job job) { run(std::move(job), &frameCounter); }
+		void endFrame();
+		JobCounter &getFrameCounter() { return frameCounter; }
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+		uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+		// 0 for the owning thread, 1..N for workers, ~0u for threads not owned by this system
+		uint32_t getThreadIndex() const;
+
+	private:
+		struct Task {
+			Job job;
+			JobCounter *counter = nullptr;
+		};
+
+		// owner pushes/pops at the back, thieves take from the front
+		struct WorkQueue {
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		void push(Task task);
+		bool tryPop(uint32_t threadIndex, Task &task);
+		bool trySteal(uint32_t threadIndex, Task &task);
+		bool tryRunOne(uint32_t threadIndex);
+		void execute(Task &task);
+		void finish(JobCounter *counter);
+		void workerLoop(uint32_t threadIndex);
+
+		std::vector<std::unique_ptr<WorkQueue>> queues;
+		std::vector<std::thread> workers;
+
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		std::atomic<uint32_t> queuedTasks{0};
+		std::atomic<bool> running{true};
+
+		JobCounter frameCounter;
+	};
+} // namespace lve
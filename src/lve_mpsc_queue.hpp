@@ -0,0 +1,86 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace lve {
+	// unbounded multi producer single consumer queue (vyukov style linked list)
+	// push is a single atomic exchange and never blocks, pop/drain may only be called from one thread
+	template<typename T>
+	class LveMpscQueue {
+	public:
+		LveMpscQueue()
+		{
+			Node *stub = new Node();
+			head.store(stub, std::memory_order_relaxed);
+			tail = stub;
+		}
+
+		~LveMpscQueue()
+		{
+			Node *node = tail;
+			while (node)
+			{
+				Node *next = node->next.load(std::memory_order_relaxed);
+				delete node;
+				node = next;
+			}
+		}
+
+		LveMpscQueue(const LveMpscQueue &) = delete;
+		LveMpscQueue &operator=(const LveMpscQueue &) = delete;
+
+		// safe from any thread
+		void push(T value)
+		{
+			Node *node = new Node(std::move(value));
+			Node *prev = head.exchange(node, std::memory_order_acq_rel);
+			// between the exchange and this store the consumer just sees an empty queue
+			prev->next.store(node, std::memory_order_release);
+		}
+
+		// consumer only
+		bool pop(T &value)
+		{
+			Node *next = tail->next.load(std::memory_order_acquire);
+			if (next == nullptr) return false;
+
+			value = std::move(next->value);
+			delete tail;
+			tail = next;
+			return true;
+		}
+
+		// consumer only, pops until empty and returns how many items were handled
+		template<typename Fn>
+		size_t drain(Fn &&fn)
+		{
+			size_t count = 0;
+			T value;
+			while (pop(value))
+			{
+				fn(value);
+				count++;
+			}
+			return count;
+		}
+
+		// consumer only, may miss a push that is still in flight
+		bool empty() const { return tail->next.load(std::memory_order_acquire) == nullptr; }
+
+	private:
+		struct Node {
+			Node() = default;
+			explicit Node(T &&value) : value{std::move(value)} {}
+
+			std::atomic<Node *> next{nullptr};
+			T value{};
+		};
+
+		// producers swing head, the consumer owns tail (always the last popped node or the stub)
+		alignas(64) std::atomic<Node *> head;
+		alignas(64) Node *tail;
+	};
+} // namespace lve
@@ -1,8 +1,10 @@
 #include "lve_pipeline.hpp"
 #include "Mesh.h"
+#include "lve_shader_cache.hpp"
 
 // std
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -12,6 +14,7 @@
 #include <sstream>
 #include <string>
 #include <stdexcept>
+#include <utility>
 
 namespace lve {
 	LvePipeline::LvePipeline(
@@ -20,11 +23,13 @@ namespace lve {
 		const std::string &fragFilepath,
 		const PipelineConfigInfo &configInfo,
 		std::vector<VkVertexInputBindingDescription> (*BindingDescriptions)(),
-		std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)())
+		std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)(),
+		const ShaderVariant &variant)
 
 		: lveDevice{device}
 	{
-		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo, BindingDescriptions, AttributeDescriptions);
+		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo, BindingDescriptions, AttributeDescriptions,
+								variant);
 	}
 
 	LvePipeline::~LvePipeline()
@@ -34,52 +39,13 @@ namespace lve {
 		vkDestroyPipeline(lveDevice.device(), graphicsPipeline, nullptr);
 	}
 
-	std::string LvePipeline::readFile(const std::string &filepath)
-	{
-		std::ifstream file(filepath, std::ios::in | std::ios::binary);
-		if (!file)
-		{
-			throw std::runtime_error("Failed to open file: " + filepath);
-		}
-
-		std::ostringstream ss;
-		ss << file.rdbuf(); // read entire file into stringstream
-		return ss.str();
-	}
-
-	std::vector<uint32_t> LvePipeline::shaderToSpirV(
-		std::string source,
-		shaderc_shader_kind kind,
-		const std::string &name,
-		const std::string &entryPoint = "main")
-	{
-		shaderc::Compiler compiler;
-		shaderc::CompileOptions options;
-
-		// Optional: enable performance optimization
-		options.SetOptimizationLevel(shaderc_optimization_level_performance);
-
-
-		// Compile GLSL to SPIR-V
-		shaderc::SpvCompilationResult module =
-				compiler.CompileGlslToSpv(source, kind, name.c_str(), entryPoint.c_str(), options);
-
-		// Check compilation status
-		if (module.GetCompilationStatus() != shaderc_compilation_status_success)
-		{
-			throw std::runtime_error("Shader compilation failed: " + module.GetErrorMessage());
-		}
-
-		// Copy SPIR-V into vector<uint32_t>
-		return {module.cbegin(), module.cend()};
-	}
-
 	void LvePipeline::createGraphicsPipeline(
 		const std::string &vertFilepath,
 		const std::string &fragFilepath,
 		const PipelineConfigInfo &configInfo,
 		std::vector<VkVertexInputBindingDescription> (*BindingDescriptions)(),
-		std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)())
+		std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)(),
+		const ShaderVariant &variant)
 	{
 		assert(
 			configInfo.pipelineLayout != VK_NULL_HANDLE &&
@@ -88,15 +54,30 @@ namespace lve {
 			configInfo.renderPass != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-		std::string vertShaderCode = readFile(vertFilepath);
-		std::string fragShaderCode = readFile(fragFilepath);
-
-		auto vertCode = shaderToSpirV(vertShaderCode, shaderc_vertex_shader, "vertexShader");
-		auto fragCode = shaderToSpirV(fragShaderCode, shaderc_fragment_shader, "fragmentShader");
+		// shaderc only runs when a source changed since the last run
+		auto vertCode = lveDevice.shaderCache().load(vertFilepath, shaderc_vertex_shader, variant.defines);
+		auto fragCode = lveDevice.shaderCache().load(fragFilepath, shaderc_fragment_shader, variant.defines);
 
 		createShaderModule(vertCode, &vertShaderModule);
 		createShaderModule(fragCode, &fragShaderModule);
 
+		// both stages get every constant, ids a stage doesn't declare are ignored
+		std::vector<VkSpecializationMapEntry> specializationEntries;
+		std::vector<uint32_t> specializationData;
+		for (const auto &constant: variant.constants)
+		{
+			specializationEntries.push_back({
+				constant.id, static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t)), sizeof(uint32_t)
+			});
+			specializationData.push_back(constant.value);
+		}
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+		specializationInfo.pMapEntries = specializationEntries.data();
+		specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+		specializationInfo.pData = specializationData.data();
+		const VkSpecializationInfo *specialization = variant.constants.empty() ? nullptr : &specializationInfo;
+
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -104,14 +85,14 @@ namespace lve {
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = specialization;
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		shaderStages[1].module = fragShaderModule;
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
+		shaderStages[1].pSpecializationInfo = specialization;
 
 		std::vector<VkVertexInputBindingDescription> bindingDescriptions = BindingDescriptions();
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions = AttributeDescriptions();
@@ -143,9 +124,10 @@ namespace lve {
 		pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+		auto start = std::chrono::steady_clock::now();
 		if (vkCreateGraphicsPipelines(
 				lveDevice.device(),
-				VK_NULL_HANDLE,
+				lveDevice.pipelineCache(),
 				1,
 				&pipelineInfo,
 				nullptr,
@@ -153,6 +135,7 @@ namespace lve {
 		{
 			throw std::runtime_error("failed to create graphics pipeline");
 		}
+		lveDevice.addPipelineCreationTime(std::chrono::steady_clock::now() - start);
 	}
 
 	void LvePipeline::createShaderModule(const std::vector<uint32_t> &code, VkShaderModule *shaderModule)
@@ -174,6 +157,13 @@ namespace lve {
 	}
 
 
+	void LvePipeline::swap(LvePipeline &other)
+	{
+		std::swap(graphicsPipeline, other.graphicsPipeline);
+		std::swap(vertShaderModule, other.vertShaderModule);
+		std::swap(fragShaderModule, other.fragShaderModule);
+	}
+
 	void LvePipeline::bind(VkCommandBuffer commandBuffer)
 	{
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
@@ -274,6 +264,24 @@ namespace lve {
 		configInfo.dynamicStateInfo.flags = 0;
 	}
 
+	void LvePipeline::transparentPipelineConfigInfo(PipelineConfigInfo &configInfo, VkExtent2D extent)
+	{
+		defaultPipelineConfigInfo(configInfo, extent);
+
+		configInfo.colorBlendAttachment.blendEnable = VK_TRUE;
+		configInfo.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		configInfo.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		configInfo.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		configInfo.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+		// transparent surfaces are tested against opaque depth but must not hide each other
+		configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		// back faces show through
+		configInfo.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+	}
+
 	void LvePipeline::shadowPipelineConfigInfo(PipelineConfigInfo &configInfo, VkExtent2D extent)
 	{
 		// Input assembly
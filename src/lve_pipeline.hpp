@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lve_device.hpp"
+#include "lve_shader_cache.hpp"
 #include "shaderc/shaderc.hpp"
 
 // std
@@ -10,6 +11,18 @@
 #include "Mesh.h"
 
 namespace lve {
+	// specialization constant for both stages, bools go in as VkBool32 and floats as their bits
+	struct SpecializationConstant {
+		uint32_t id;
+		uint32_t value;
+	};
+
+	// one permutation of a shader pair, defines are compiled in by shaderc and constants by the driver
+	struct ShaderVariant {
+		std::vector<ShaderDefine> defines;
+		std::vector<SpecializationConstant> constants;
+	};
+
 	struct PipelineConfigInfo {
 		PipelineConfigInfo(const PipelineConfigInfo &) = delete;
 
@@ -39,7 +52,8 @@ namespace lve {
 			const std::string &fragFilepath,
 			const PipelineConfigInfo &configInfo,
 			std::vector<VkVertexInputBindingDescription> (*BindingDescriptions)() = RenderBucket::getBindingDescriptions,
-			std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)() = RenderBucket::getAttributeDescriptions);
+			std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)() = RenderBucket::getAttributeDescriptions,
+			const ShaderVariant &variant = {});
 
 		~LvePipeline();
 
@@ -47,26 +61,24 @@ namespace lve {
 		LvePipeline &operator=(const LvePipeline &) = delete;
 
 		void bind(VkCommandBuffer commandBuffer);
+		// exchanges the vulkan objects, a rebuilt pipeline takes the place of one that is referenced everywhere
+		void swap(LvePipeline &other);
 
 		static void defaultPipelineConfigInfo(PipelineConfigInfo &configInfo, VkExtent2D extent = VkExtent2D{0, 0});
 		static void shadowPipelineConfigInfo(PipelineConfigInfo &configInfo, VkExtent2D extent = VkExtent2D{0, 0});
+		// default with alpha blending, depth test without depth writes
+		static void transparentPipelineConfigInfo(PipelineConfigInfo &configInfo, VkExtent2D extent = VkExtent2D{0, 0});
 
 		VkPipeline getPipeline() const {return graphicsPipeline; };
 
 	private:
-		static std::string readFile(const std::string &filepath);
-
-		static std::vector<uint32_t> shaderToSpirV(std::string source,
-													shaderc_shader_kind kind,
-													const std::string &name,
-													const std::string &entryPoint);
-
 		void createGraphicsPipeline(
 			const std::string &vertFilepath,
 			const std::string &fragFilepath,
 			const PipelineConfigInfo &configInfo,
 			std::vector<VkVertexInputBindingDescription> (*BindingDescriptions)(),
-			std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)());
+			std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)(),
+			const ShaderVariant &variant);
 
 		void createShaderModule(const std::vector<uint32_t> &code, VkShaderModule *shaderModule);
 
@@ -0,0 +1,69 @@
+#include "lve_pipeline_build_queue.hpp"
+#include "lve_pipeline_library.hpp"
+
+// std
+#include <iostream>
+
+namespace lve {
+	LvePipelineBuildQueue::LvePipelineBuildQueue(LveDevice &device, LveJobSystem &jobSystem)
+		: device{device}, jobSystem{jobSystem}
+	{
+	}
+
+	LvePipelineBuildQueue::~LvePipelineBuildQueue()
+	{
+		// failures already went to the futures, nothing may escape a destructor
+		jobSystem.wait(counter);
+	}
+
+	std::future<LvePipeline *> LvePipelineBuildQueue::submit(PipelineBuildDesc desc)
+	{
+		// std::function has to be copyable, so the promise is shared
+		auto promise = std::make_shared<std::promise<LvePipeline *> >();
+		auto future = promise->get_future();
+
+		{
+			std::lock_guard lock{mutex};
+			if (submitted++ == 0) batchStart = std::chrono::steady_clock::now();
+		}
+
+		jobSystem.run([this, promise, desc = std::move(desc)]() {
+			try
+			{
+				PipelineConfigInfo config{};
+				desc.configure(config);
+				promise->set_value(&device.pipelineLibrary().get(
+					desc.vertFilepath, desc.fragFilepath, config,
+					desc.bindingDescriptions, desc.attributeDescriptions, desc.variant));
+			} catch (...)
+			{
+				{
+					std::lock_guard lock{mutex};
+					if (!firstError) firstError = std::current_exception();
+				}
+				promise->set_exception(std::current_exception());
+			}
+		}, &counter);
+
+		return future;
+	}
+
+	void LvePipelineBuildQueue::wait()
+	{
+		jobSystem.wait(counter);
+
+		std::exception_ptr error;
+		{
+			std::lock_guard lock{mutex};
+			if (submitted > 0)
+			{
+				auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart);
+				std::cout << "built " << submitted << " pipelines in " << ms.count() << " ms on "
+						<< jobSystem.getThreadCount() << " threads\n";
+			}
+			submitted = 0;
+			std::swap(error, firstError);
+		}
+		if (error) std::rethrow_exception(error);
+	}
+} // namespace lve
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "lve_job_system.hpp"
+#include "lve_pipeline.hpp"
+
+// std
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace lve {
+	// everything a worker needs to build one pipeline. PipelineConfigInfo points into itself and can't be
+	// copied, so configure fills it in on the worker instead
+	struct PipelineBuildDesc {
+		std::string vertFilepath;
+		std::string fragFilepath;
+		std::function<void(PipelineConfigInfo &)> configure;
+		std::vector<VkVertexInputBindingDescription> (*bindingDescriptions)() = RenderBucket::getBindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> (*attributeDescriptions)() =
+				RenderBucket::getAttributeDescriptions;
+		ShaderVariant variant;
+	};
+
+	// builds pipelines on the job system, shaderc and vkCreateGraphicsPipelines included. submit every
+	// pipeline up front and wait once, startup then takes as long as the slowest pipeline instead of the sum.
+	// pipelines come from the device's pipeline library, a desc that matches an existing one builds nothing.
+	// the shader cache, the library and the VkPipelineCache are all safe to share between the workers
+	class LvePipelineBuildQueue {
+	public:
+		LvePipelineBuildQueue(LveDevice &device, LveJobSystem &jobSystem);
+		// waits for whatever is still building, the descs may reference objects owned by the caller
+		~LvePipelineBuildQueue();
+
+		LvePipelineBuildQueue(const LvePipelineBuildQueue &) = delete;
+		LvePipelineBuildQueue &operator=(const LvePipelineBuildQueue &) = delete;
+
+		// the future holds the pipeline, owned by the library, or the exception the build threw
+		std::future<LvePipeline *> submit(PipelineBuildDesc desc);
+
+		// helps building until everything submitted so far is done, rethrows the first failed build
+		void wait();
+		uint32_t getPending() const { return counter.getPending(); }
+
+	private:
+		LveDevice &device;
+		LveJobSystem &jobSystem;
+		JobCounter counter;
+
+		std::mutex mutex;
+		std::exception_ptr firstError;
+		uint32_t submitted = 0; // since the last wait
+		std::chrono::steady_clock::time_point batchStart;
+	};
+} // namespace lve
@@ -0,0 +1,569 @@
+#include "lve_pipeline_library.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <tuple>
+
+namespace lve {
+	// appends whole fields, never raw structs, so padding and pointers stay out of the key
+	struct KeyWriter {
+		std::vector<uint32_t> &words;
+
+		void u32(uint32_t value) { words.push_back(value); }
+
+		void u64(uint64_t value)
+		{
+			words.push_back(static_cast<uint32_t>(value));
+			words.push_back(static_cast<uint32_t>(value >> 32));
+		}
+
+		void f32(float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			words.push_back(bits);
+		}
+
+		void string(const std::string &value)
+		{
+			u32(static_cast<uint32_t>(value.size()));
+			for (size_t i = 0; i < value.size(); i += 4)
+			{
+				uint32_t word = 0;
+				std::memcpy(&word, value.data() + i, std::min<size_t>(4, value.size() - i));
+				words.push_back(word);
+			}
+		}
+
+		void stencil(const VkStencilOpState &op)
+		{
+			u32(op.failOp);
+			u32(op.passOp);
+			u32(op.depthFailOp);
+			u32(op.compareOp);
+			u32(op.compareMask);
+			u32(op.writeMask);
+			u32(op.reference);
+		}
+	};
+
+	// vulkan handles are pointers on 64 bit and integers on 32 bit builds
+	template<typename T>
+	static uint64_t handleBits(T handle)
+	{
+		uint64_t bits = 0;
+		std::memcpy(&bits, &handle, sizeof(handle));
+		return bits;
+	}
+
+	// fnv-1a over the words
+	static uint64_t hashWords(uint64_t hash, const std::vector<uint32_t> &words)
+	{
+		for (uint32_t word: words)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				hash ^= (word >> (i * 8)) & 0xff;
+				hash *= 0x100000001b3ull;
+			}
+		}
+		return hash;
+	}
+
+	static uint64_t hashString(uint64_t hash, const std::string &value)
+	{
+		for (unsigned char c: value)
+		{
+			hash ^= c;
+			hash *= 0x100000001b3ull;
+		}
+		// keeps the vertex and fragment path apart
+		hash ^= 0xff;
+		hash *= 0x100000001b3ull;
+		return hash;
+	}
+
+	LvePipelineLibrary::LvePipelineLibrary(LveDevice &device) : device{device}
+	{
+	}
+
+	LvePipelineLibrary::~LvePipelineLibrary()
+	{
+		for (auto &[compatibility, renderPass]: compatiblePasses)
+			vkDestroyRenderPass(device.device(), renderPass, nullptr);
+		for (auto &[description, layout]: layoutsByDescription)
+			vkDestroyPipelineLayout(device.device(), layout, nullptr);
+		for (VkDescriptorSetLayout setLayout: setLayouts)
+			vkDestroyDescriptorSetLayout(device.device(), setLayout, nullptr);
+	}
+
+	LvePipeline &LvePipelineLibrary::get(
+		const std::string &vertFilepath,
+		const std::string &fragFilepath,
+		const PipelineConfigInfo &configInfo,
+		std::vector<VkVertexInputBindingDescription> (*BindingDescriptions)(),
+		std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)(),
+		const ShaderVariant &variant)
+	{
+		PipelineKey key = makeKey(vertFilepath, fragFilepath, configInfo, BindingDescriptions(),
+								AttributeDescriptions(), variant, pipelineLayoutKey(configInfo.pipelineLayout),
+								renderPassKey(configInfo.renderPass));
+
+		// the first caller of a key builds it, everyone else waits on its future
+		std::promise<LvePipeline *> promise;
+		std::shared_future<LvePipeline *> entry;
+		bool owner = false;
+		{
+			std::lock_guard lock{mutex};
+			auto it = pipelines.find(key);
+			if (it != pipelines.end())
+				entry = it->second;
+			else
+			{
+				pipelines.emplace(key, promise.get_future().share());
+				owner = true;
+			}
+		}
+		if (!owner)
+		{
+			hits++;
+			return *entry.get();
+		}
+
+		misses++;
+		try
+		{
+			auto pipeline = std::make_unique<LvePipeline>(device, vertFilepath, fragFilepath, configInfo,
+														BindingDescriptions, AttributeDescriptions, variant);
+			LvePipeline *result = pipeline.get();
+			auto config = keepConfig(configInfo);
+			{
+				std::lock_guard lock{mutex};
+				built.push_back({
+					std::move(pipeline), vertFilepath, fragFilepath, std::move(config),
+					BindingDescriptions, AttributeDescriptions, variant
+				});
+			}
+			promise.set_value(result);
+			return *result;
+		} catch (...)
+		{
+			// waiters see the error, the next get tries again
+			promise.set_exception(std::current_exception());
+			std::lock_guard lock{mutex};
+			pipelines.erase(key);
+			throw;
+		}
+	}
+
+	void LvePipelineLibrary::registerRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo &info)
+	{
+		uint64_t compatibility = renderPassCompatibility(info);
+		std::lock_guard lock{mutex};
+		// a destroyed pass may hand its handle to a new one, the newest registration wins
+		renderPasses[renderPass] = compatibility;
+		if (compatiblePasses.count(compatibility)) return;
+
+		VkRenderPass compatiblePass;
+		if (vkCreateRenderPass(device.device(), &info, nullptr, &compatiblePass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create compatible render pass!");
+		}
+		compatiblePasses.emplace(compatibility, compatiblePass);
+	}
+
+	VkPipelineLayout LvePipelineLibrary::getPipelineLayout(
+		const std::vector<const LveDescriptorSetLayout *> &setLayoutsIn,
+		const std::vector<VkPushConstantRange> &pushConstantRanges)
+	{
+		// the order of bindings and ranges means nothing, sorted they describe the layout exactly
+		std::vector<std::vector<VkDescriptorSetLayoutBinding> > sets;
+		std::vector<uint32_t> description;
+		KeyWriter w{description};
+		w.u32(static_cast<uint32_t>(setLayoutsIn.size()));
+		for (const LveDescriptorSetLayout *setLayout: setLayoutsIn)
+		{
+			auto &bindings = sets.emplace_back();
+			for (const auto &[index, binding]: setLayout->getBindings())
+			{
+				assert(binding.pImmutableSamplers == nullptr && "immutable samplers can't be interned");
+				bindings.push_back(binding);
+			}
+			std::sort(bindings.begin(), bindings.end(), [](const auto &a, const auto &b) {
+				return a.binding < b.binding;
+			});
+
+			w.u32(static_cast<uint32_t>(bindings.size()));
+			for (const auto &binding: bindings)
+			{
+				w.u32(binding.binding);
+				w.u32(binding.descriptorType);
+				w.u32(binding.descriptorCount);
+				w.u32(binding.stageFlags);
+			}
+		}
+
+		std::vector<VkPushConstantRange> ranges = pushConstantRanges;
+		std::sort(ranges.begin(), ranges.end(), [](const auto &a, const auto &b) {
+			return std::tie(a.offset, a.size, a.stageFlags) < std::tie(b.offset, b.size, b.stageFlags);
+		});
+		w.u32(static_cast<uint32_t>(ranges.size()));
+		for (const auto &range: ranges)
+		{
+			w.u32(range.stageFlags);
+			w.u32(range.offset);
+			w.u32(range.size);
+		}
+
+		std::lock_guard lock{mutex};
+		auto it = layoutsByDescription.find(description);
+		if (it != layoutsByDescription.end()) return it->second;
+
+		std::vector<VkDescriptorSetLayout> handles;
+		for (const auto &bindings: sets)
+		{
+			VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+			setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+			setLayoutInfo.pBindings = bindings.data();
+			VkDescriptorSetLayout setLayout;
+			if (vkCreateDescriptorSetLayout(device.device(), &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create descriptor set layout!");
+			}
+			setLayouts.push_back(setLayout);
+			handles.push_back(setLayout);
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(handles.size());
+		pipelineLayoutInfo.pSetLayouts = handles.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(ranges.size());
+		pipelineLayoutInfo.pPushConstantRanges = ranges.data();
+		VkPipelineLayout layout;
+		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		layoutsByDescription.emplace(std::move(description), layout);
+		pipelineLayouts.emplace(layout, pipelineLayouts.size());
+		return layout;
+	}
+
+	size_t LvePipelineLibrary::reload(const std::string &path)
+	{
+		struct Rebuild {
+			LvePipeline *target;
+			std::string vertFilepath;
+			std::string fragFilepath;
+			const PipelineConfigInfo *config; // heap allocated and never changed, safe to read unlocked
+			std::vector<VkVertexInputBindingDescription> (*bindingDescriptions)();
+			std::vector<VkVertexInputAttributeDescription> (*attributeDescriptions)();
+			ShaderVariant variant;
+		};
+
+		std::vector<Rebuild> rebuilds;
+		{
+			std::lock_guard lock{mutex};
+			for (const auto &entry: built)
+				if (entry.config && (entry.vertFilepath == path || entry.fragFilepath == path))
+					rebuilds.push_back({
+						entry.pipeline.get(), entry.vertFilepath, entry.fragFilepath, entry.config.get(),
+						entry.bindingDescriptions, entry.attributeDescriptions, entry.variant
+					});
+		}
+
+		size_t rebuilt = 0;
+		for (auto &rebuild: rebuilds)
+		{
+			try
+			{
+				auto pipeline = std::make_shared<LvePipeline>(
+					device, rebuild.vertFilepath, rebuild.fragFilepath, *rebuild.config,
+					rebuild.bindingDescriptions, rebuild.attributeDescriptions, rebuild.variant);
+				std::lock_guard lock{mutex};
+				pendingSwaps.push_back({rebuild.target, std::move(pipeline)});
+				rebuilt++;
+			} catch (const std::exception &e)
+			{
+				std::cerr << "rebuilding a pipeline after " << path << " changed failed, keeping the old one: "
+						<< e.what() << std::endl;
+			}
+		}
+		return rebuilt;
+	}
+
+	void LvePipelineLibrary::applyReloads()
+	{
+		std::vector<Swap> swaps;
+		{
+			std::lock_guard lock{mutex};
+			swaps.swap(pendingSwaps);
+		}
+
+		for (auto &swap: swaps)
+		{
+			swap.target->swap(*swap.rebuilt);
+			// rebuilt holds the old objects now, frames in flight may still use them
+			device.deletionQueue().retire([old = std::move(swap.rebuilt)]() mutable { old.reset(); });
+		}
+		if (!swaps.empty())
+			std::cout << "swapped in " << swaps.size() << " rebuilt pipelines" << std::endl;
+	}
+
+	std::vector<std::string> LvePipelineLibrary::getShaderPaths()
+	{
+		std::vector<std::string> paths;
+		{
+			std::lock_guard lock{mutex};
+			for (const auto &entry: built)
+			{
+				paths.push_back(entry.vertFilepath);
+				paths.push_back(entry.fragFilepath);
+			}
+		}
+		std::sort(paths.begin(), paths.end());
+		paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+		return paths;
+	}
+
+	std::unique_ptr<PipelineConfigInfo> LvePipelineLibrary::keepConfig(const PipelineConfigInfo &configInfo)
+	{
+		// static viewports and sample masks point at memory of the caller
+		if (configInfo.viewportInfo.pViewports || configInfo.viewportInfo.pScissors ||
+			configInfo.multisampleInfo.pSampleMask || configInfo.colorBlendInfo.attachmentCount > 1)
+			return nullptr;
+
+		auto config = std::make_unique<PipelineConfigInfo>();
+		config->viewportInfo = configInfo.viewportInfo;
+		config->inputAssemblyInfo = configInfo.inputAssemblyInfo;
+		config->rasterizationInfo = configInfo.rasterizationInfo;
+		config->multisampleInfo = configInfo.multisampleInfo;
+		config->colorBlendInfo = configInfo.colorBlendInfo;
+		if (configInfo.colorBlendInfo.attachmentCount == 1)
+			config->colorBlendAttachment = configInfo.colorBlendInfo.pAttachments[0];
+		config->colorBlendInfo.pAttachments = &config->colorBlendAttachment;
+		config->depthStencilInfo = configInfo.depthStencilInfo;
+		config->dynamicStateEnables.assign(configInfo.dynamicStateInfo.pDynamicStates,
+											configInfo.dynamicStateInfo.pDynamicStates +
+											configInfo.dynamicStateInfo.dynamicStateCount);
+		config->dynamicStateInfo = configInfo.dynamicStateInfo;
+		config->dynamicStateInfo.pDynamicStates = config->dynamicStateEnables.data();
+		config->pipelineLayout = configInfo.pipelineLayout;
+		config->subpass = configInfo.subpass;
+
+		// the caller's pass may be destroyed by the time a shader changes, the library's own one is not
+		std::lock_guard lock{mutex};
+		auto pass = renderPasses.find(configInfo.renderPass);
+		config->renderPass = pass != renderPasses.end() ? compatiblePasses[pass->second] : configInfo.renderPass;
+		return config;
+	}
+
+	uint64_t LvePipelineLibrary::renderPassKey(VkRenderPass renderPass)
+	{
+		std::lock_guard lock{mutex};
+		auto it = renderPasses.find(renderPass);
+		return it != renderPasses.end() ? it->second : handleBits(renderPass);
+	}
+
+	uint64_t LvePipelineLibrary::pipelineLayoutKey(VkPipelineLayout layout)
+	{
+		std::lock_guard lock{mutex};
+		auto it = pipelineLayouts.find(layout);
+		assert(it != pipelineLayouts.end() && "pipeline layouts have to come from getPipelineLayout");
+		return it != pipelineLayouts.end() ? it->second : handleBits(layout);
+	}
+
+	size_t LvePipelineLibrary::size()
+	{
+		std::lock_guard lock{mutex};
+		return pipelines.size();
+	}
+
+	PipelineKey LvePipelineLibrary::makeKey(
+		const std::string &vertFilepath,
+		const std::string &fragFilepath,
+		const PipelineConfigInfo &configInfo,
+		const std::vector<VkVertexInputBindingDescription> &bindings,
+		const std::vector<VkVertexInputAttributeDescription> &attributes,
+		const ShaderVariant &variant,
+		uint64_t pipelineLayoutKey,
+		uint64_t renderPassKey)
+	{
+		PipelineKey key;
+		key.vertFilepath = vertFilepath;
+		key.fragFilepath = fragFilepath;
+		key.state.reserve(128);
+		KeyWriter w{key.state};
+
+		// defines change the spir-v, constants only the pipeline, both tell variants apart
+		w.u32(static_cast<uint32_t>(variant.defines.size()));
+		for (const auto &define: variant.defines)
+		{
+			w.string(define.name);
+			w.string(define.value);
+		}
+		w.u32(static_cast<uint32_t>(variant.constants.size()));
+		for (const auto &constant: variant.constants)
+		{
+			w.u32(constant.id);
+			w.u32(constant.value);
+		}
+
+		w.u32(static_cast<uint32_t>(bindings.size()));
+		for (const auto &binding: bindings)
+		{
+			w.u32(binding.binding);
+			w.u32(binding.stride);
+			w.u32(binding.inputRate);
+		}
+		w.u32(static_cast<uint32_t>(attributes.size()));
+		for (const auto &attribute: attributes)
+		{
+			w.u32(attribute.location);
+			w.u32(attribute.binding);
+			w.u32(attribute.format);
+			w.u32(attribute.offset);
+		}
+
+		const auto &assembly = configInfo.inputAssemblyInfo;
+		w.u32(assembly.topology);
+		w.u32(assembly.primitiveRestartEnable);
+
+		const auto &viewport = configInfo.viewportInfo;
+		w.u32(viewport.viewportCount);
+		w.u32(viewport.scissorCount);
+		// null when viewport and scissor are dynamic
+		w.u32(viewport.pViewports != nullptr);
+		for (uint32_t i = 0; viewport.pViewports && i < viewport.viewportCount; i++)
+		{
+			const VkViewport &v = viewport.pViewports[i];
+			w.f32(v.x);
+			w.f32(v.y);
+			w.f32(v.width);
+			w.f32(v.height);
+			w.f32(v.minDepth);
+			w.f32(v.maxDepth);
+		}
+		w.u32(viewport.pScissors != nullptr);
+		for (uint32_t i = 0; viewport.pScissors && i < viewport.scissorCount; i++)
+		{
+			const VkRect2D &s = viewport.pScissors[i];
+			w.u32(static_cast<uint32_t>(s.offset.x));
+			w.u32(static_cast<uint32_t>(s.offset.y));
+			w.u32(s.extent.width);
+			w.u32(s.extent.height);
+		}
+
+		const auto &raster = configInfo.rasterizationInfo;
+		w.u32(raster.depthClampEnable);
+		w.u32(raster.rasterizerDiscardEnable);
+		w.u32(raster.polygonMode);
+		w.u32(raster.cullMode);
+		w.u32(raster.frontFace);
+		w.u32(raster.depthBiasEnable);
+		w.f32(raster.depthBiasConstantFactor);
+		w.f32(raster.depthBiasClamp);
+		w.f32(raster.depthBiasSlopeFactor);
+		w.f32(raster.lineWidth);
+
+		const auto &multisample = configInfo.multisampleInfo;
+		w.u32(multisample.rasterizationSamples);
+		w.u32(multisample.sampleShadingEnable);
+		w.f32(multisample.minSampleShading);
+		w.u32(multisample.alphaToCoverageEnable);
+		w.u32(multisample.alphaToOneEnable);
+		w.u32(multisample.pSampleMask != nullptr);
+		uint32_t sampleMaskWords = (static_cast<uint32_t>(multisample.rasterizationSamples) + 31) / 32;
+		for (uint32_t i = 0; multisample.pSampleMask && i < sampleMaskWords; i++)
+			w.u32(multisample.pSampleMask[i]);
+
+		const auto &blend = configInfo.colorBlendInfo;
+		w.u32(blend.logicOpEnable);
+		w.u32(blend.logicOp);
+		w.u32(blend.attachmentCount);
+		for (uint32_t i = 0; i < blend.attachmentCount; i++)
+		{
+			const VkPipelineColorBlendAttachmentState &a = blend.pAttachments[i];
+			w.u32(a.blendEnable);
+			w.u32(a.srcColorBlendFactor);
+			w.u32(a.dstColorBlendFactor);
+			w.u32(a.colorBlendOp);
+			w.u32(a.srcAlphaBlendFactor);
+			w.u32(a.dstAlphaBlendFactor);
+			w.u32(a.alphaBlendOp);
+			w.u32(a.colorWriteMask);
+		}
+		for (float constant: blend.blendConstants)
+			w.f32(constant);
+
+		const auto &depth = configInfo.depthStencilInfo;
+		w.u32(depth.depthTestEnable);
+		w.u32(depth.depthWriteEnable);
+		w.u32(depth.depthCompareOp);
+		w.u32(depth.depthBoundsTestEnable);
+		w.f32(depth.minDepthBounds);
+		w.f32(depth.maxDepthBounds);
+		w.u32(depth.stencilTestEnable);
+		w.stencil(depth.front);
+		w.stencil(depth.back);
+
+		// the order dynamic states are listed in means nothing
+		const auto &dynamic = configInfo.dynamicStateInfo;
+		std::vector<VkDynamicState> dynamicStates(dynamic.pDynamicStates,
+												dynamic.pDynamicStates + dynamic.dynamicStateCount);
+		std::sort(dynamicStates.begin(), dynamicStates.end());
+		w.u32(static_cast<uint32_t>(dynamicStates.size()));
+		for (VkDynamicState state: dynamicStates)
+			w.u32(state);
+
+		w.u64(pipelineLayoutKey);
+		w.u64(renderPassKey);
+		w.u32(configInfo.subpass);
+
+		uint64_t hash = 0xcbf29ce484222325ull;
+		hash = hashString(hash, vertFilepath);
+		hash = hashString(hash, fragFilepath);
+		key.hash = hashWords(hash, key.state);
+		return key;
+	}
+
+	uint64_t LvePipelineLibrary::renderPassCompatibility(const VkRenderPassCreateInfo &info)
+	{
+		std::vector<uint32_t> words;
+		KeyWriter w{words};
+
+		w.u32(info.attachmentCount);
+		for (uint32_t i = 0; i < info.attachmentCount; i++)
+		{
+			w.u32(info.pAttachments[i].format);
+			w.u32(info.pAttachments[i].samples);
+		}
+
+		// layouts don't matter for compatibility, only which attachment sits in which slot
+		auto references = [&w](const VkAttachmentReference *refs, uint32_t count) {
+			w.u32(refs ? count : 0);
+			for (uint32_t i = 0; refs && i < count; i++)
+				w.u32(refs[i].attachment);
+		};
+
+		w.u32(info.subpassCount);
+		for (uint32_t i = 0; i < info.subpassCount; i++)
+		{
+			const VkSubpassDescription &subpass = info.pSubpasses[i];
+			w.u32(subpass.pipelineBindPoint);
+			references(subpass.pInputAttachments, subpass.inputAttachmentCount);
+			references(subpass.pColorAttachments, subpass.colorAttachmentCount);
+			references(subpass.pResolveAttachments, subpass.colorAttachmentCount);
+			references(subpass.pDepthStencilAttachment, 1);
+		}
+
+		return hashWords(0xcbf29ce484222325ull, words);
+	}
+} // namespace lve
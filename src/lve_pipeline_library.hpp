@@ -0,0 +1,131 @@
+#pragma once
+
+#include "lve_descriptors.hpp"
+#include "lve_pipeline.hpp"
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+	// canonical form of everything vkCreateGraphicsPipelines reads: shaders and their variant, vertex layout, input assembly,
+	// viewport, raster, multisample, blend, depth, dynamic state, layout and render pass compatibility.
+	// fields are written one by one, so padding and pointers never end up in the key
+	struct PipelineKey {
+		std::string vertFilepath;
+		std::string fragFilepath;
+		std::vector<uint32_t> state;
+		uint64_t hash = 0;
+
+		bool operator==(const PipelineKey &other) const
+		{
+			return hash == other.hash && state == other.state && vertFilepath == other.vertFilepath &&
+					fragFilepath == other.fragFilepath;
+		}
+	};
+
+	struct PipelineKeyHash {
+		size_t operator()(const PipelineKey &key) const noexcept { return static_cast<size_t>(key.hash); }
+	};
+
+	// one pipeline per distinct description, shared by every system that asks for the same state.
+	// missing pipelines are built by the first caller, concurrent callers of the same key wait for that build.
+	// pipelines live as long as the library, and so do the layouts in their keys, which all come from
+	// getPipelineLayout().
+	// reload() rebuilds every pipeline that uses a changed shader on the calling thread, applyReloads() swaps
+	// them in at a frame boundary and retires the old objects through the deletion queue. thread safe
+	class LvePipelineLibrary {
+	public:
+		explicit LvePipelineLibrary(LveDevice &device);
+		~LvePipelineLibrary();
+
+		LvePipelineLibrary(const LvePipelineLibrary &) = delete;
+		LvePipelineLibrary &operator=(const LvePipelineLibrary &) = delete;
+
+		LvePipeline &get(
+			const std::string &vertFilepath,
+			const std::string &fragFilepath,
+			const PipelineConfigInfo &configInfo,
+			std::vector<VkVertexInputBindingDescription> (*BindingDescriptions)() = RenderBucket::getBindingDescriptions,
+			std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)() = RenderBucket::getAttributeDescriptions,
+			const ShaderVariant &variant = {});
+
+		// keys use the compatibility class of a registered pass instead of its handle, so a recreated swap chain
+		// pass or any other compatible pass finds the pipelines built for the old one.
+		// the library keeps its own pass per class to rebuild against, the registered one may be gone by then
+		void registerRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo &info);
+
+		// layouts are interned by the bindings of their set layouts and their push constant ranges, so every
+		// system with the same interface gets the same handle and shares its pipelines with the others.
+		// the library owns the layout and its own copies of the set layouts, don't destroy it
+		VkPipelineLayout getPipelineLayout(const std::vector<const LveDescriptorSetLayout *> &setLayouts,
+											const std::vector<VkPushConstantRange> &pushConstantRanges = {});
+
+		// rebuilds the pipelines that use the shader at path, a pipeline that fails to build keeps the old
+		// version. returns how many were rebuilt
+		size_t reload(const std::string &path);
+		// call it where nothing is recording, the new pipelines are used from the next command buffer on
+		void applyReloads();
+		// every shader some pipeline was built from
+		std::vector<std::string> getShaderPaths();
+
+		static PipelineKey makeKey(
+			const std::string &vertFilepath,
+			const std::string &fragFilepath,
+			const PipelineConfigInfo &configInfo,
+			const std::vector<VkVertexInputBindingDescription> &bindings,
+			const std::vector<VkVertexInputAttributeDescription> &attributes,
+			const ShaderVariant &variant,
+			uint64_t pipelineLayoutKey,
+			uint64_t renderPassKey);
+		// attachment formats and sample counts plus the attachment references of every subpass,
+		// what vulkan compares when it checks render pass compatibility
+		static uint64_t renderPassCompatibility(const VkRenderPassCreateInfo &info);
+
+		size_t size();
+		uint32_t getHits() const { return hits; }
+		uint32_t getMisses() const { return misses; }
+
+	private:
+		// what it takes to build a pipeline again once one of its shaders changed
+		struct Built {
+			std::unique_ptr<LvePipeline> pipeline;
+			std::string vertFilepath;
+			std::string fragFilepath;
+			std::unique_ptr<PipelineConfigInfo> config; // null when the config can't be kept around
+			std::vector<VkVertexInputBindingDescription> (*bindingDescriptions)();
+			std::vector<VkVertexInputAttributeDescription> (*attributeDescriptions)();
+			ShaderVariant variant;
+		};
+
+		struct Swap {
+			LvePipeline *target;
+			std::shared_ptr<LvePipeline> rebuilt;
+		};
+
+		uint64_t renderPassKey(VkRenderPass renderPass);
+		uint64_t pipelineLayoutKey(VkPipelineLayout layout);
+		// deep copy that points into itself again, null for state that lives outside the config
+		std::unique_ptr<PipelineConfigInfo> keepConfig(const PipelineConfigInfo &configInfo);
+
+		LveDevice &device;
+
+		std::mutex mutex;
+		std::unordered_map<PipelineKey, std::shared_future<LvePipeline *>, PipelineKeyHash> pipelines;
+		std::vector<Built> built;
+		std::unordered_map<VkRenderPass, uint64_t> renderPasses;
+		std::unordered_map<uint64_t, VkRenderPass> compatiblePasses; // owned, one per compatibility class
+		std::map<std::vector<uint32_t>, VkPipelineLayout> layoutsByDescription; // owned
+		std::unordered_map<VkPipelineLayout, uint64_t> pipelineLayouts; // index in the order they were interned
+		std::vector<VkDescriptorSetLayout> setLayouts; // owned, the interned layouts were made from them
+		std::vector<Swap> pendingSwaps;
+		std::atomic<uint32_t> hits{0}, misses{0};
+	};
+} // namespace lve
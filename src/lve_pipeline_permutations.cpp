@@ -0,0 +1,67 @@
+#include "lve_pipeline_permutations.hpp"
+#include "lve_pipeline_library.hpp"
+
+// std
+#include <cassert>
+
+namespace lve {
+	LvePipelinePermutations::LvePipelinePermutations(LveDevice &device, PipelineBuildDesc base,
+													std::vector<std::string> features)
+		: device{device}, base{std::move(base)}, features{std::move(features)}
+	{
+		assert(this->features.size() < 32 && "variants are 32 bit masks");
+	}
+
+	LvePipeline &LvePipelinePermutations::get(uint32_t variant)
+	{
+		ShaderVariant shaderVariant;
+		uint32_t version;
+		{
+			std::lock_guard lock{mutex};
+			auto it = variants.find(variant);
+			if (it != variants.end()) return *it->second;
+			shaderVariant = makeVariantLocked(variant);
+			version = constantsVersion;
+		}
+
+		// built outside the lock, the library makes concurrent builds of the same variant wait for one
+		PipelineConfigInfo config{};
+		base.configure(config);
+		LvePipeline &pipeline = device.pipelineLibrary().get(
+			base.vertFilepath, base.fragFilepath, config,
+			base.bindingDescriptions, base.attributeDescriptions, shaderVariant);
+
+		std::lock_guard lock{mutex};
+		if (version == constantsVersion)
+			variants.emplace(variant, &pipeline);
+		return pipeline;
+	}
+
+	PipelineBuildDesc LvePipelinePermutations::describe(uint32_t variant)
+	{
+		PipelineBuildDesc desc = base;
+		std::lock_guard lock{mutex};
+		desc.variant = makeVariantLocked(variant);
+		return desc;
+	}
+
+	void LvePipelinePermutations::setConstants(std::vector<SpecializationConstant> constants)
+	{
+		std::lock_guard lock{mutex};
+		this->constants = std::move(constants);
+		constantsVersion++;
+		variants.clear();
+	}
+
+	ShaderVariant LvePipelinePermutations::makeVariantLocked(uint32_t variant) const
+	{
+		assert(variant < getVariantCount() && "variant uses a feature bit that has no define");
+
+		ShaderVariant shaderVariant;
+		for (uint32_t i = 0; i < features.size(); i++)
+			if (variant & (1u << i))
+				shaderVariant.defines.push_back({features[i], "1"});
+		shaderVariant.constants = constants;
+		return shaderVariant;
+	}
+} // namespace lve
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "lve_pipeline_build_queue.hpp"
+
+// std
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+	// the shader variants of one pipeline. bit i of a variant compiles features[i] in as a define, so a draw
+	// only runs the code its material needs instead of branching on it. the specialization constants apply
+	// to every variant. variants are built on first use and come from the device's pipeline library,
+	// so hot reload and the shared cache work for them as for any other pipeline. thread safe
+	class LvePipelinePermutations {
+	public:
+		LvePipelinePermutations(LveDevice &device, PipelineBuildDesc base, std::vector<std::string> features);
+
+		LvePipelinePermutations(const LvePipelinePermutations &) = delete;
+		LvePipelinePermutations &operator=(const LvePipelinePermutations &) = delete;
+
+		LvePipeline &get(uint32_t variant);
+		VkPipeline getPipeline(uint32_t variant) { return get(variant).getPipeline(); }
+
+		// for building variants ahead of time on the build queue, get() then finds them in the library
+		PipelineBuildDesc describe(uint32_t variant);
+
+		// variants built from now on use these, switching back to older values finds the old pipelines again
+		void setConstants(std::vector<SpecializationConstant> constants);
+		uint32_t getVariantCount() const { return 1u << features.size(); }
+
+	private:
+		ShaderVariant makeVariantLocked(uint32_t variant) const;
+
+		LveDevice &device;
+		PipelineBuildDesc base;
+		std::vector<std::string> features;
+
+		std::mutex mutex;
+		std::vector<SpecializationConstant> constants;
+		uint32_t constantsVersion = 0;
+		std::unordered_map<uint32_t, LvePipeline *> variants; // built with the current constants
+	};
+} // namespace lve
@@ -0,0 +1,45 @@
+#include "lve_render_queue.hpp"
+
+// std
+#include <array>
+
+namespace lve {
+	void radixSort(std::vector<RenderQueueEntry> &entries, std::vector<RenderQueueEntry> &scratch)
+	{
+		const size_t count = entries.size();
+		if (count < 2) return;
+		scratch.resize(count);
+
+		// one read over the keys fills the histograms of all 8 bytes
+		std::array<std::array<uint32_t, 256>, 8> histograms{};
+		for (const RenderQueueEntry &entry: entries)
+		{
+			for (uint32_t byte = 0; byte < 8; byte++)
+				histograms[byte][entry.key >> (byte * 8) & 0xff]++;
+		}
+
+		std::vector<RenderQueueEntry> *source = &entries;
+		std::vector<RenderQueueEntry> *target = &scratch;
+		for (uint32_t byte = 0; byte < 8; byte++)
+		{
+			auto &histogram = histograms[byte];
+			uint8_t firstValue = static_cast<uint8_t>((*source)[0].key >> (byte * 8));
+			if (histogram[firstValue] == count) continue; // all keys agree on this byte
+
+			std::array<uint32_t, 256> offsets;
+			uint32_t sum = 0;
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				offsets[i] = sum;
+				sum += histogram[i];
+			}
+
+			for (const RenderQueueEntry &entry: *source)
+				(*target)[offsets[entry.key >> (byte * 8) & 0xff]++] = entry;
+			std::swap(source, target);
+		}
+
+		if (source != &entries)
+			entries.swap(scratch);
+	}
+} // namespace lve
@@ -0,0 +1,59 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+	// 64 bit draw sort key, most significant first:
+	// pass(4) | pipeline(8) | mesh(16) | material(12) | depth(24)
+	// sorting by it groups draws by state first and only orders by depth inside a group
+	namespace RenderKey {
+		constexpr uint32_t DEPTH_BITS = 24, MATERIAL_BITS = 12, MESH_BITS = 16, PIPELINE_BITS = 8, PASS_BITS = 4;
+		constexpr uint32_t DEPTH_SHIFT = 0;
+		constexpr uint32_t MATERIAL_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+		constexpr uint32_t MESH_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+		constexpr uint32_t PIPELINE_SHIFT = MESH_SHIFT + MESH_BITS;
+		constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+		static_assert(PASS_SHIFT + PASS_BITS == 64, "render key has to fill 64 bits exactly");
+
+		constexpr uint32_t PASS_OPAQUE = 0;
+		constexpr uint32_t PASS_TRANSPARENT = 1;
+
+		constexpr uint64_t mask(uint32_t bits) { return (uint64_t{1} << bits) - 1; }
+
+		constexpr uint64_t make(uint32_t pass, uint32_t pipeline, uint32_t mesh, uint32_t material, uint32_t depth)
+		{
+			return (uint64_t{pass} & mask(PASS_BITS)) << PASS_SHIFT |
+					(uint64_t{pipeline} & mask(PIPELINE_BITS)) << PIPELINE_SHIFT |
+					(uint64_t{mesh} & mask(MESH_BITS)) << MESH_SHIFT |
+					(uint64_t{material} & mask(MATERIAL_BITS)) << MATERIAL_SHIFT |
+					(uint64_t{depth} & mask(DEPTH_BITS)) << DEPTH_SHIFT;
+		}
+
+		constexpr uint32_t pass(uint64_t key) { return static_cast<uint32_t>(key >> PASS_SHIFT & mask(PASS_BITS)); }
+		constexpr uint32_t pipeline(uint64_t key) { return static_cast<uint32_t>(key >> PIPELINE_SHIFT & mask(PIPELINE_BITS)); }
+		constexpr uint32_t mesh(uint64_t key) { return static_cast<uint32_t>(key >> MESH_SHIFT & mask(MESH_BITS)); }
+		constexpr uint32_t material(uint64_t key) { return static_cast<uint32_t>(key >> MATERIAL_SHIFT & mask(MATERIAL_BITS)); }
+
+		// everything above depth, draws can only be merged while this stays the same
+		constexpr uint64_t stateBits(uint64_t key) { return key >> MESH_SHIFT; }
+
+		// maps [0, maxDistance] onto the depth bits, further away sorts later
+		inline uint32_t quantizeDepth(float distance, float maxDistance)
+		{
+			float t = std::clamp(distance / maxDistance, 0.f, 1.f);
+			return static_cast<uint32_t>(t * static_cast<float>(mask(DEPTH_BITS)));
+		}
+	}
+
+	struct RenderQueueEntry {
+		uint64_t key;
+		uint32_t index; // whatever the caller wants back, usually an instance index
+	};
+
+	// stable lsd radix sort on the key, 8 bits per pass. passes where every key has the same byte are skipped,
+	// so keys that only use a few fields cost only a few passes. scratch is resized as needed
+	void radixSort(std::vector<RenderQueueEntry> &entries, std::vector<RenderQueueEntry> &scratch);
+} // namespace lve
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Mesh.h"
+#include "keyboard_movement_controller.hpp"
+#include "lve_shadowMap.h"
+
+#include "imgui.h"
+
+// std
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace lve {
+	struct LightSnapshot {
+		PointLight light;
+		// shared, so a light removed on the simulation thread can't free the map while this frame still uses it
+		std::shared_ptr<ShadowMap> shadowMap;
+	};
+
+	// draw data of one imgui frame, optionally deep copied so the next NewFrame can't touch it
+	struct ImGuiSnapshot {
+		struct DrawListDeleter {
+			void operator()(ImDrawList *list) const { IM_DELETE(list); }
+		};
+
+		ImDrawData *drawData = nullptr;
+		ImDrawData copy;
+		std::vector<std::unique_ptr<ImDrawList, DrawListDeleter>> lists;
+
+		void capture(ImDrawData *source, bool deepCopy)
+		{
+			lists.clear();
+			if (!deepCopy || source == nullptr)
+			{
+				drawData = source;
+				return;
+			}
+
+			copy = *source;
+			copy.CmdLists.resize(0);
+			for (ImDrawList *list: source->CmdLists)
+			{
+				lists.emplace_back(list->CloneOutput());
+				copy.CmdLists.push_back(lists.back().get());
+			}
+			drawData = &copy;
+		}
+	};
+
+	// everything the render side needs for one frame, produced by the simulation side
+	struct RenderSnapshot {
+		GlobalUbo ubo{};
+		BucketFrame bucket;
+		std::vector<LightSnapshot> lights;
+		ImGuiSnapshot imGui;
+		double deltaTime = 0;
+		std::chrono::steady_clock::time_point inputTime{};
+	};
+} // namespace lve
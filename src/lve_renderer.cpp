@@ -1,9 +1,12 @@
 #include "lve_renderer.hpp"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <stdexcept>
+#include <thread>
 
 #include <iostream>
 
@@ -11,34 +14,171 @@ namespace lve {
 	LveRenderer::LveRenderer(LveWindow &window, LveDevice &device)
 		: lveWindow{window}, lveDevice{device}
 	{
+		createFrameTimeline();
 		recreateSwapChain();
 		createCommandBuffers();
 	}
 
-	LveRenderer::~LveRenderer() { freeCommandBuffers(); }
+	LveRenderer::~LveRenderer()
+	{
+		waitForFrameValue(frameValue);
+		lveDevice.deletionQueue().collect(frameValue);
+		destroySecondaryCommandPools();
+		freeCommandBuffers();
+		vkDestroySemaphore(lveDevice.device(), frameTimeline, nullptr);
+	}
+
+	void LveRenderer::createFrameTimeline()
+	{
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		if (vkCreateSemaphore(lveDevice.device(), &semaphoreInfo, nullptr, &frameTimeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create frame timeline semaphore!");
+		}
+		slotValues.assign(LveSwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+	}
+
+	uint64_t LveRenderer::getCompletedFrameValue() const
+	{
+		uint64_t completed = 0;
+		vkGetSemaphoreCounterValue(lveDevice.device(), frameTimeline, &completed);
+		return completed;
+	}
+
+	void LveRenderer::waitForFrameValue(uint64_t value) const
+	{
+		if (value == 0) return;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &frameTimeline;
+		waitInfo.pValues = &value;
+		vkWaitSemaphores(lveDevice.device(), &waitInfo, UINT64_MAX);
+	}
 
 	void LveRenderer::recreateSwapChain()
 	{
 		auto extent = lveWindow.getExtent();
 		while (extent.width == 0 || extent.height == 0)
 		{
+			if (waitForEvents)
+				glfwWaitEvents();
+			else if (lveWindow.shouldClose())
+				return;
+			else
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
 			extent = lveWindow.getExtent();
-			glfwWaitEvents();
 		}
-		vkDeviceWaitIdle(lveDevice.device());
 
 		if (lveSwapChain == nullptr)
 		{
-			lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent);
+			lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, profile.presentMode);
 		} else
 		{
+			// no device idle, frames in flight keep rendering into the old chain while the new one is built
 			std::shared_ptr<LveSwapChain> oldSwapChain = std::move(lveSwapChain);
-			lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, oldSwapChain);
+			lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, oldSwapChain, profile.presentMode);
 
 			if (!oldSwapChain->compareSwapFormats(*lveSwapChain.get()))
 			{
 				throw std::runtime_error("Swap chain image(or depth) format has changed!");
 			}
+
+			// its framebuffers and depth images go once the last frame submitted to it is done. presents
+			// aren't tracked by the frame timeline, the extra frames in flight give them time to let go of
+			// the old render finished semaphores
+			lveDevice.deletionQueue().retire(
+				frameValue + LveSwapChain::MAX_FRAMES_IN_FLIGHT,
+				[oldSwapChain = std::move(oldSwapChain)]() mutable { oldSwapChain.reset(); });
+		}
+	}
+
+	void LveRenderer::setLatencyProfile(const LveLatencyProfile &newProfile)
+	{
+		std::lock_guard lock{profileMutex};
+		pendingProfile = newProfile;
+		pendingProfile.framesInFlight = std::clamp<uint32_t>(
+			pendingProfile.framesInFlight, 1, LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		profileChanged = true;
+	}
+
+	LveLatencyProfile LveRenderer::getLatencyProfile() const
+	{
+		std::lock_guard lock{profileMutex};
+		return profileChanged ? pendingProfile : profile;
+	}
+
+	double LveRenderer::getMeasuredLatency(LatencyMode mode) const
+	{
+		std::lock_guard lock{profileMutex};
+		return measuredLatency[static_cast<size_t>(mode)];
+	}
+
+	void LveRenderer::applyLatencyProfile()
+	{
+		LveLatencyProfile previous = profile;
+		{
+			std::lock_guard lock{profileMutex};
+			if (!profileChanged) return;
+			profile = pendingProfile;
+			profileChanged = false;
+		}
+
+		// the slot wait in waitForNextFrame covers fewer frames in flight, so only the present mode rebuilds
+		if (profile.framesInFlight != previous.framesInFlight)
+			currentFrameIndex %= profile.framesInFlight;
+		if (profile.maxFrameRate != previous.maxFrameRate)
+			nextFrameTime = {};
+		if (profile.presentMode != previous.presentMode)
+			recreateSwapChain();
+	}
+
+	void LveRenderer::waitForNextFrame()
+	{
+		if (frameWaited) return;
+		applyLatencyProfile();
+
+		if (profile.maxFrameRate > 0)
+		{
+			auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(1.0 / profile.maxFrameRate));
+			auto now = std::chrono::steady_clock::now();
+			if (now < nextFrameTime)
+				std::this_thread::sleep_until(nextFrameTime);
+			// a late frame starts a new schedule instead of rushing to catch up
+			nextFrameTime = std::max(nextFrameTime, now) + period;
+		}
+
+		// the frame that last used this slot has to be done before its buffers are recorded again,
+		// and no more than framesInFlight frames may be queued when the count just went down
+		uint64_t oldest = frameValue >= profile.framesInFlight ? frameValue + 1 - profile.framesInFlight : 0;
+		waitForFrameValue(std::max(slotValues[currentFrameIndex], oldest));
+
+		uint64_t completed = getCompletedFrameValue();
+		collectLatencySamples(completed);
+		lveDevice.deletionQueue().collect(completed);
+		frameWaited = true;
+	}
+
+	void LveRenderer::collectLatencySamples(uint64_t completedValue)
+	{
+		auto now = std::chrono::steady_clock::now();
+		std::lock_guard lock{profileMutex};
+		while (!latencySamples.empty() && latencySamples.front().frameValue <= completedValue)
+		{
+			LatencySample &sample = latencySamples.front();
+			double ms = std::chrono::duration<double, std::milli>(now - sample.inputTime).count();
+			double &average = measuredLatency[static_cast<size_t>(sample.mode)];
+			average = average == 0 ? ms : average * 0.9 + ms * 0.1;
+			latencySamples.pop_front();
 		}
 	}
 
@@ -69,10 +209,132 @@ namespace lve {
 		commandBuffers.clear();
 	}
 
+	void LveRenderer::createSecondaryCommandPools(uint32_t threadCount)
+	{
+		destroySecondaryCommandPools();
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = lveDevice.findPhysicalQueueFamilies().graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		// + 1 for threads that are not part of the job system
+		secondaryPools.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto &framePools: secondaryPools)
+		{
+			framePools.resize(threadCount + 1);
+			for (auto &threadPool: framePools)
+			{
+				if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &threadPool.pool) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create secondary command pool!");
+				}
+			}
+		}
+	}
+
+	void LveRenderer::destroySecondaryCommandPools()
+	{
+		for (auto &framePools: secondaryPools)
+			for (auto &threadPool: framePools)
+				vkDestroyCommandPool(lveDevice.device(), threadPool.pool, nullptr);
+		secondaryPools.clear();
+	}
+
+	void LveRenderer::resetSecondaryCommandPools()
+	{
+		if (secondaryPools.empty()) return;
+
+		// the slot value has been waited on, nothing recorded from these pools is in flight anymore
+		for (auto &threadPool: secondaryPools[currentFrameIndex])
+		{
+			if (threadPool.used == 0) continue;
+			vkResetCommandPool(lveDevice.device(), threadPool.pool, 0);
+			threadPool.used = 0;
+		}
+	}
+
+	VkCommandBuffer LveRenderer::beginSecondaryCommandBuffer(uint32_t threadIndex)
+	{
+		return beginSecondaryCommandBuffer(
+			threadIndex,
+			lveSwapChain->getRenderPass(),
+			lveSwapChain->getFrameBuffer(currentImageIndex),
+			lveSwapChain->getSwapChainExtent());
+	}
+
+	VkCommandBuffer LveRenderer::beginSecondaryCommandBuffer(
+		uint32_t threadIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent)
+	{
+		assert(isFrameStarted && "Can't record secondary command buffers if frame is not in progress");
+		assert(!secondaryPools.empty() && "createSecondaryCommandPools has not been called");
+
+		auto &framePools = secondaryPools[currentFrameIndex];
+		auto &threadPool = framePools[std::min<size_t>(threadIndex, framePools.size() - 1)];
+
+		if (threadPool.used == threadPool.buffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = threadPool.pool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to allocate secondary command buffer!");
+			}
+			threadPool.buffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = threadPool.buffers[threadPool.used++];
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = framebuffer;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+						VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+
+		// dynamic state is not inherited from the primary buffer
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		VkRect2D scissor{{0, 0}, extent};
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		return commandBuffer;
+	}
+
+	void LveRenderer::endSecondaryCommandBuffer(VkCommandBuffer commandBuffer)
+	{
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to record secondary command buffer!");
+		}
+	}
+
 	VkCommandBuffer LveRenderer::beginFrame()
 	{
 		assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
+		waitForNextFrame();
+
 		auto result = lveSwapChain->acquireNextImage(&currentImageIndex);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
@@ -86,6 +348,7 @@ namespace lve {
 		}
 
 		isFrameStarted = true;
+		resetSecondaryCommandPools();
 
 		auto commandBuffer = getCurrentCommandBuffer();
 		VkCommandBufferBeginInfo beginInfo{};
@@ -107,7 +370,18 @@ namespace lve {
 			throw std::runtime_error("failed to record command buffer!");
 		}
 
-		auto result = lveSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+		slotValues[currentFrameIndex] = ++frameValue;
+		if (frameInputTime != std::chrono::steady_clock::time_point{})
+		{
+			std::lock_guard lock{profileMutex};
+			latencySamples.push_back({frameValue, frameInputTime, profile.mode});
+		}
+		frameInputTime = {};
+		frameWaited = false;
+		auto result = lveSwapChain->submitCommandBuffers(
+			&commandBuffer, &currentImageIndex, frameTimeline, frameValue);
+		// anything retired from here on may be referenced by the next frame
+		lveDevice.deletionQueue().setRetireValue(frameValue + 1);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
 			lveWindow.wasWindowResized())
 		{
@@ -119,10 +393,10 @@ namespace lve {
 		}
 
 		isFrameStarted = false;
-		currentFrameIndex = (currentFrameIndex + 1) % LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+		currentFrameIndex = (currentFrameIndex + 1) % profile.framesInFlight;
 	}
 
-	void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 	{
 		assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
 		assert(
@@ -143,7 +417,10 @@ namespace lve {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+		// secondary buffers set their own viewport, inline commands are not allowed in that case
+		if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) return;
 
 		VkViewport viewport{};
 		viewport.x = 0.0f;
@@ -5,11 +5,38 @@
 #include "lve_window.hpp"
 
 // std
+#include <array>
 #include <cassert>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 namespace lve {
+enum class LatencyMode : uint8_t { lowLatency, throughput, vsync, capped, count };
+
+struct LveLatencyProfile {
+  LatencyMode mode = LatencyMode::throughput;
+  uint32_t framesInFlight = 3;  // 1 to LveSwapChain::MAX_FRAMES_IN_FLIGHT
+  VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+  double maxFrameRate = 0;  // 0 for uncapped
+  // the app waits for the frame slot before it polls input instead of in beginFrame, so input is
+  // sampled as late as possible at the cost of cpu and gpu no longer overlapping
+  bool justInTimeInput = false;
+
+  static LveLatencyProfile lowLatency() {
+    return {LatencyMode::lowLatency, 1, VK_PRESENT_MODE_MAILBOX_KHR, 0, true};
+  }
+  static LveLatencyProfile throughput() {
+    return {LatencyMode::throughput, 3, VK_PRESENT_MODE_MAILBOX_KHR, 0, false};
+  }
+  static LveLatencyProfile vsync() { return {LatencyMode::vsync, 2, VK_PRESENT_MODE_FIFO_KHR, 0, false}; }
+  static LveLatencyProfile capped(double frameRate = 60) {
+    return {LatencyMode::capped, 2, VK_PRESENT_MODE_MAILBOX_KHR, frameRate, false};
+  }
+};
+
 class LveRenderer {
 public:
   LveRenderer(LveWindow &window, LveDevice &device);
@@ -22,6 +49,8 @@ public:
   float getAspectRatio() const { return lveSwapChain->extentAspectRatio(); }
   bool isFrameInProgress() const { return isFrameStarted; }
   LveSwapChain* getSwapChain() const {return lveSwapChain.get();}
+  // off the main thread glfw events can't be pumped, so a minimized window is polled instead
+  void setWaitForEvents(bool wait) { waitForEvents = wait; }
 
   VkCommandBuffer getCurrentCommandBuffer() const {
     assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
@@ -33,23 +62,87 @@ public:
     return currentFrameIndex;
   }
 
+  // takes effect at the start of the next frame. a new present mode recreates the swap chain, frames
+  // in flight and the frame cap don't rebuild anything. thread safe
+  void setLatencyProfile(const LveLatencyProfile &profile);
+  LveLatencyProfile getLatencyProfile() const;
+  // average time from input sample to the gpu finishing the frame in ms, 0 before the mode has run.
+  // completion is noticed at frame boundaries, so it can be late by up to one frame of cpu time
+  double getMeasuredLatency(LatencyMode mode) const;
+  // frame limiter and the wait for a free frame slot, beginFrame does it if the app hasn't
+  void waitForNextFrame();
+  // when the input the current frame is built from was sampled
+  void setFrameInputTime(std::chrono::steady_clock::time_point time) { frameInputTime = time; }
+
+  // frame counter on a timeline semaphore, frame n signals n once the gpu is done with it
+  VkSemaphore getFrameTimeline() const { return frameTimeline; }
+  // value of the last submitted frame
+  uint64_t getFrameValue() const { return frameValue; }
+  uint64_t getCompletedFrameValue() const;
+  void waitForFrameValue(uint64_t value) const;
+
   VkCommandBuffer beginFrame();
   void endFrame();
-  void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+  void beginSwapChainRenderPass(
+      VkCommandBuffer commandBuffer,
+      VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
   void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+  // one pool per recording thread and frame in flight, threads past threadCount share the last one
+  void createSecondaryCommandPools(uint32_t threadCount);
+  // secondary buffer that continues the swap chain render pass of the current frame
+  VkCommandBuffer beginSecondaryCommandBuffer(uint32_t threadIndex);
+  VkCommandBuffer beginSecondaryCommandBuffer(
+      uint32_t threadIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+  void endSecondaryCommandBuffer(VkCommandBuffer commandBuffer);
+
 private:
+  struct SecondaryCommandPool {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> buffers;
+    uint32_t used = 0;
+  };
+
+  void createFrameTimeline();
   void createCommandBuffers();
   void freeCommandBuffers();
+  void destroySecondaryCommandPools();
+  void resetSecondaryCommandPools();
   void recreateSwapChain();
+  void applyLatencyProfile();
+  void collectLatencySamples(uint64_t completedValue);
 
   LveWindow &lveWindow;
   LveDevice &lveDevice;
   std::unique_ptr<LveSwapChain> lveSwapChain;
   std::vector<VkCommandBuffer> commandBuffers;
+  // indexed [frameIndex][threadIndex]
+  std::vector<std::vector<SecondaryCommandPool>> secondaryPools;
+
+  VkSemaphore frameTimeline = VK_NULL_HANDLE;
+  uint64_t frameValue{0};
+  // value each frame in flight slot was last submitted with
+  std::vector<uint64_t> slotValues;
+
+  struct LatencySample {
+    uint64_t frameValue;
+    std::chrono::steady_clock::time_point inputTime;
+    LatencyMode mode;
+  };
+
+  mutable std::mutex profileMutex;
+  LveLatencyProfile profile = LveLatencyProfile::throughput();
+  LveLatencyProfile pendingProfile = profile;
+  bool profileChanged{false};
+  std::array<double, static_cast<size_t>(LatencyMode::count)> measuredLatency{};
+  std::deque<LatencySample> latencySamples;
+  std::chrono::steady_clock::time_point frameInputTime{};
+  std::chrono::steady_clock::time_point nextFrameTime{};
+  bool frameWaited{false};
 
   uint32_t currentImageIndex;
   int currentFrameIndex{0};
   bool isFrameStarted{false};
+  bool waitForEvents{true};
 };
 }  // namespace lve
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "lve_shader_cache.hpp"
+
+// std
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace lve {
+	// bump when the file layout, the compile options or what goes into the key change
+	static constexpr uint32_t CACHE_FORMAT_VERSION = 2;
+
+	// sha256 of the shaderc library this was built against, set by cmake
+#ifndef LVE_SHADERC_ID
+#define LVE_SHADERC_ID "unknown"
+#endif
+	static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+	// fnv-1a, stable across runs and platforms unlike std::hash
+	static void hashBytes(uint64_t &hash, const void *data, size_t size)
+	{
+		const auto *bytes = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+	}
+
+	static void hashString(uint64_t &hash, const std::string &value)
+	{
+		// the length keeps "ab" + "c" apart from "a" + "bc"
+		uint64_t size = value.size();
+		hashBytes(hash, &size, sizeof(size));
+		hashBytes(hash, value.data(), value.size());
+	}
+
+	LveShaderCache::LveShaderCache(std::filesystem::path directory) : directory{std::move(directory)}
+	{
+		std::error_code error;
+		std::filesystem::create_directories(this->directory, error);
+		if (error)
+			std::cerr << "shader cache disabled, can't create " << this->directory << ": " << error.message() << std::endl;
+	}
+
+	std::vector<uint32_t> LveShaderCache::load(const std::string &path, shaderc_shader_kind kind,
+												const std::vector<ShaderDefine> &defines,
+												const std::string &entryPoint)
+	{
+		return load(readFile(path), path, kind, defines, entryPoint);
+	}
+
+	std::vector<uint32_t> LveShaderCache::load(const std::string &source, const std::string &name,
+												shaderc_shader_kind kind, const std::vector<ShaderDefine> &defines,
+												const std::string &entryPoint)
+	{
+		uint64_t key = makeKey(source, kind, defines, entryPoint);
+
+		// the first caller of a key builds it, everyone else waits on its future. parallel pipeline builds
+		// that share a shader then compile it once instead of racing
+		std::promise<std::vector<uint32_t> > promise;
+		std::shared_future<std::vector<uint32_t> > entry;
+		bool owner = false;
+		{
+			std::lock_guard lock{mutex};
+			auto it = memory.find(key);
+			if (it != memory.end())
+			{
+				hits++;
+				entry = it->second;
+			} else
+			{
+				memory.emplace(key, promise.get_future().share());
+				owner = true;
+			}
+		}
+		if (!owner)
+			return entry.get();
+
+		try
+		{
+			std::vector<uint32_t> code;
+			if (readEntry(key, code))
+				hits++;
+			else
+			{
+				// compiled outside the lock, other shaders can be looked up meanwhile
+				misses++;
+				code = compile(source, name, kind, defines, entryPoint);
+				writeEntry(key, code);
+			}
+			promise.set_value(code);
+			return code;
+		} catch (...)
+		{
+			// waiters see the error, the next load tries again
+			promise.set_exception(std::current_exception());
+			std::lock_guard lock{mutex};
+			memory.erase(key);
+			throw;
+		}
+	}
+
+	std::vector<uint32_t> LveShaderCache::compile(const std::string &source, const std::string &name,
+												shaderc_shader_kind kind, const std::vector<ShaderDefine> &defines,
+												const std::string &entryPoint)
+	{
+		shaderc::Compiler compiler;
+		shaderc::CompileOptions options;
+		options.SetOptimizationLevel(shaderc_optimization_level_performance);
+		for (const auto &define: defines)
+			options.AddMacroDefinition(define.name, define.value);
+
+		shaderc::SpvCompilationResult module =
+				compiler.CompileGlslToSpv(source, kind, name.c_str(), entryPoint.c_str(), options);
+
+		if (module.GetCompilationStatus() != shaderc_compilation_status_success)
+		{
+			throw std::runtime_error("Shader compilation failed: " + module.GetErrorMessage());
+		}
+		return {module.cbegin(), module.cend()};
+	}
+
+	std::string LveShaderCache::readFile(const std::string &path)
+	{
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (!file)
+		{
+			throw std::runtime_error("Failed to open file: " + path);
+		}
+
+		std::ostringstream ss;
+		ss << file.rdbuf();
+		return ss.str();
+	}
+
+	uint64_t LveShaderCache::makeKey(const std::string &source, shaderc_shader_kind kind,
+									const std::vector<ShaderDefine> &defines, const std::string &entryPoint)
+	{
+		unsigned int spvVersion = 0, spvRevision = 0;
+		shaderc_get_spv_version(&spvVersion, &spvRevision);
+
+		uint64_t hash = 0xcbf29ce484222325ull;
+		uint32_t header[] = {
+			CACHE_FORMAT_VERSION, spvVersion, spvRevision,
+			static_cast<uint32_t>(kind), static_cast<uint32_t>(shaderc_optimization_level_performance)
+		};
+		hashBytes(hash, header, sizeof(header));
+		hashString(hash, LVE_SHADERC_ID);
+		hashString(hash, entryPoint);
+		for (const auto &define: defines)
+		{
+			hashString(hash, define.name);
+			hashString(hash, define.value);
+		}
+		hashString(hash, source);
+		return hash;
+	}
+
+	std::filesystem::path LveShaderCache::entryPath(uint64_t key) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(key));
+		return directory / name;
+	}
+
+	bool LveShaderCache::readEntry(uint64_t key, std::vector<uint32_t> &code) const
+	{
+		std::ifstream file(entryPath(key), std::ios::binary | std::ios::ate);
+		if (!file) return false;
+
+		auto size = static_cast<size_t>(file.tellg());
+		if (size == 0 || size % sizeof(uint32_t) != 0) return false;
+
+		code.resize(size / sizeof(uint32_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char *>(code.data()), static_cast<std::streamsize>(size));
+		// a torn or foreign file just compiles again
+		return file && code[0] == SPIRV_MAGIC;
+	}
+
+	void LveShaderCache::writeEntry(uint64_t key, const std::vector<uint32_t> &code) const
+	{
+		// written next to the entry and renamed, a reader never sees half a file
+		std::filesystem::path path = entryPath(key);
+		std::filesystem::path temp = path;
+		temp += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+		{
+			std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+			if (!file) return;
+			file.write(reinterpret_cast<const char *>(code.data()),
+						static_cast<std::streamsize>(code.size() * sizeof(uint32_t)));
+			if (!file) return;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temp, path, error);
+		if (error) std::filesystem::remove(temp, error);
+	}
+} // namespace lve
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "shaderc/shaderc.hpp"
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+	struct ShaderDefine {
+		std::string name;
+		std::string value;
+	};
+
+	// compiles glsl to spir-v through shaderc and keeps the result on disk, one file per key.
+	// the key hashes the source, defines, stage, entry point, optimization level and the shaderc build
+	// (a hash of the library cmake linked), so a changed source or compiler never hits a stale entry.
+	// entries are also kept in memory, so pipelines built twice from the same shader compile once, even when
+	// both are built at the same time. thread safe
+	class LveShaderCache {
+	public:
+		explicit LveShaderCache(std::filesystem::path directory = "cache/shaders");
+
+		LveShaderCache(const LveShaderCache &) = delete;
+		LveShaderCache &operator=(const LveShaderCache &) = delete;
+
+		// reads the glsl file at path, compiles it only when no cache entry matches
+		std::vector<uint32_t> load(const std::string &path, shaderc_shader_kind kind,
+									const std::vector<ShaderDefine> &defines = {},
+									const std::string &entryPoint = "main");
+		std::vector<uint32_t> load(const std::string &source, const std::string &name, shaderc_shader_kind kind,
+									const std::vector<ShaderDefine> &defines, const std::string &entryPoint);
+
+		// always runs shaderc, throws with the compiler log on errors
+		static std::vector<uint32_t> compile(const std::string &source, const std::string &name,
+											shaderc_shader_kind kind, const std::vector<ShaderDefine> &defines,
+											const std::string &entryPoint);
+
+		static std::string readFile(const std::string &path);
+
+		uint32_t getHits() const { return hits; }
+		uint32_t getMisses() const { return misses; }
+
+	private:
+		static uint64_t makeKey(const std::string &source, shaderc_shader_kind kind,
+								const std::vector<ShaderDefine> &defines, const std::string &entryPoint);
+		std::filesystem::path entryPath(uint64_t key) const;
+		bool readEntry(uint64_t key, std::vector<uint32_t> &code) const;
+		void writeEntry(uint64_t key, const std::vector<uint32_t> &code) const;
+
+		std::filesystem::path directory;
+		std::mutex mutex;
+		std::unordered_map<uint64_t, std::shared_future<std::vector<uint32_t> > > memory; // ready or still compiling
+		std::atomic<uint32_t> hits{0}, misses{0};
+	};
+} // namespace lve
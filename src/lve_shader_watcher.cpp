@@ -0,0 +1,140 @@
+#include "lve_shader_watcher.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace lve {
+	// how often the loop checks for shutdown, and how long a burst of writes may take
+	static constexpr int POLL_INTERVAL_MS = 100;
+	static constexpr int SETTLE_MS = 50;
+
+	static std::string normalize(const std::filesystem::path &path)
+	{
+		std::error_code error;
+		std::filesystem::path absolute = std::filesystem::absolute(path, error);
+		return (error ? path : absolute).lexically_normal().string();
+	}
+
+	LveShaderWatcher::LveShaderWatcher(const std::vector<std::string> &paths, Callback onChanged)
+		: onChanged{std::move(onChanged)}
+	{
+		for (const auto &path: paths)
+			watched.emplace(normalize(path), path);
+
+#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotifyFd < 0)
+		{
+			std::cerr << "shader hot reload disabled, inotify_init1 failed" << std::endl;
+			return;
+		}
+
+		// files are replaced by some editors, only a watch on the directory survives that
+		for (const auto &[normalized, path]: watched)
+		{
+			std::filesystem::path directory = std::filesystem::path(normalized).parent_path();
+			if (std::any_of(directories.begin(), directories.end(),
+							[&](const auto &entry) { return entry.second == directory; }))
+				continue;
+
+			int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd < 0)
+				std::cerr << "shader hot reload can't watch " << directory << std::endl;
+			else
+				directories.emplace(wd, directory);
+		}
+#else
+		for (const auto &[normalized, path]: watched)
+		{
+			std::error_code error;
+			writeTimes[normalized] = std::filesystem::last_write_time(normalized, error);
+		}
+#endif
+
+		thread = std::thread(&LveShaderWatcher::run, this);
+	}
+
+	LveShaderWatcher::~LveShaderWatcher()
+	{
+		running = false;
+		if (thread.joinable()) thread.join();
+#ifdef __linux__
+		if (inotifyFd >= 0) close(inotifyFd);
+#endif
+	}
+
+	void LveShaderWatcher::run()
+	{
+		std::vector<std::string> changed;
+		while (running)
+		{
+			waitForChanges(POLL_INTERVAL_MS, changed);
+			if (changed.empty()) continue;
+
+			// editors write in several steps, wait until it went quiet
+			size_t count;
+			do
+			{
+				count = changed.size();
+				waitForChanges(SETTLE_MS, changed);
+			} while (changed.size() != count && running);
+
+			std::sort(changed.begin(), changed.end());
+			changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+			for (const auto &path: changed)
+			{
+				try
+				{
+					onChanged(path);
+				} catch (const std::exception &e)
+				{
+					std::cerr << "shader reload of " << path << " failed: " << e.what() << std::endl;
+				}
+			}
+			changed.clear();
+		}
+	}
+
+	void LveShaderWatcher::waitForChanges(int timeoutMs, std::vector<std::string> &changed)
+	{
+#ifdef __linux__
+		pollfd descriptor{inotifyFd, POLLIN, 0};
+		if (poll(&descriptor, 1, timeoutMs) <= 0) return;
+
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+		{
+			for (char *at = buffer; at < buffer + length;)
+			{
+				auto *event = reinterpret_cast<inotify_event *>(at);
+				at += sizeof(inotify_event) + event->len;
+
+				auto directory = directories.find(event->wd);
+				if (event->len == 0 || directory == directories.end()) continue;
+
+				auto it = watched.find((directory->second / event->name).lexically_normal().string());
+				if (it != watched.end()) changed.push_back(it->second);
+			}
+		}
+#else
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+		for (auto &[normalized, writeTime]: writeTimes)
+		{
+			std::error_code error;
+			auto time = std::filesystem::last_write_time(normalized, error);
+			if (error || time == writeTime) continue;
+			writeTime = time;
+			changed.push_back(watched[normalized]);
+		}
+#endif
+	}
+} // namespace lve
@@ -0,0 +1,42 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+	// watches shader sources and calls onChanged from its own thread once a file was saved.
+	// linux uses inotify on the parent directories, which also catches editors that save through a rename,
+	// elsewhere the modification times are polled. bursts of writes to one file report it once
+	class LveShaderWatcher {
+	public:
+		using Callback = std::function<void(const std::string &path)>;
+
+		LveShaderWatcher(const std::vector<std::string> &paths, Callback onChanged);
+		~LveShaderWatcher();
+
+		LveShaderWatcher(const LveShaderWatcher &) = delete;
+		LveShaderWatcher &operator=(const LveShaderWatcher &) = delete;
+
+	private:
+		void run();
+		// blocks up to timeoutMs, adds every watched file that changed meanwhile
+		void waitForChanges(int timeoutMs, std::vector<std::string> &changed);
+
+		Callback onChanged;
+		// normalized path to the path the caller passed in, which is what gets reported
+		std::unordered_map<std::string, std::string> watched;
+		std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes; // polling only
+
+		int inotifyFd = -1;
+		std::unordered_map<int, std::filesystem::path> directories; // inotify watch descriptor to directory
+
+		std::atomic<bool> running{true};
+		std::thread thread;
+	};
+} // namespace lve
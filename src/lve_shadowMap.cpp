@@ -11,12 +11,17 @@ namespace lve {
 
 	ShadowMap::~ShadowMap()
 	{
-		vkDestroyImage(lveDevice.device(), image, nullptr);
-		vkDestroyImageView(lveDevice.device(), imageView, nullptr);
-		vkDestroySampler(lveDevice.device(), sampler, nullptr);
+		// binding 4 of the frames in flight may still point at it
+		lveDevice.deletionQueue().retire(
+			[&device = lveDevice, image = image, allocation = allocation, view = imageView, sampler = sampler]() mutable {
+				vkDestroyImageView(device.device(), view, nullptr);
+				vkDestroySampler(device.device(), sampler, nullptr);
+				device.allocator().destroyImage(image, allocation);
+			});
 	}
 
-	void ShadowMap::beginRender(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer)
+	void ShadowMap::beginRender(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer,
+								VkSubpassContents contents)
 	{
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -30,7 +35,8 @@ namespace lve {
 		renderPassInfo.clearValueCount = 1;
 		renderPassInfo.pClearValues = &clearValue;
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+		if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) return;
 
 		VkViewport viewport{};
 		viewport.x = 0.0f;
@@ -76,30 +82,7 @@ namespace lve {
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-		if (vkCreateImage(lveDevice.device(), &imageInfo, nullptr, &image) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create shadow map image!");
-		}
-
-		// memory
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(lveDevice.device(), image, &memRequirements);
-
-		// allocate
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = lveDevice.findMemoryType(
-			memRequirements.memoryTypeBits,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-		);
-
-		if (vkAllocateMemory(lveDevice.device(), &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to allocate shadow map memory!");
-		}
-
-		vkBindImageMemory(lveDevice.device(), image, imageMemory, 0);
+		lveDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, allocation);
 
 		// ---- IMAGE VIEW ----
 		VkImageViewCreateInfo viewInfo{};
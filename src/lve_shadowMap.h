@@ -30,18 +30,23 @@ namespace lve {
 		ShadowMap(const ShadowMap &) = delete;
 		ShadowMap &operator=(const ShadowMap &) = delete;
 
-		void beginRender(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer);
+		void beginRender(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer,
+						VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endRender(VkCommandBuffer commandBuffer);
 
 		VkImage getImage() const { return image; }
 		VkImageView getImageView() const { return imageView; }
 		VkSampler getSampler() const {return sampler; }
 		VkExtent2D getExtent() const { return extent; }
+		VkDescriptorImageInfo descriptorInfo() const
+		{
+			return {sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+		}
 
 	private:
 		void create();
 
-		VkDeviceMemory imageMemory;
+		LveAllocation allocation{};
 		VkImage image = VK_NULL_HANDLE;
 		VkImageView imageView = VK_NULL_HANDLE;
 		VkSampler sampler = VK_NULL_HANDLE;
@@ -52,7 +57,7 @@ namespace lve {
 
 	struct PointLightData {
 		PointLight light;
-		std::unique_ptr<ShadowMap> shadowMap;
+		std::shared_ptr<ShadowMap> shadowMap; // snapshots of frames not yet submitted hold it too
 		bool dirty = true;
 
 		void create()
@@ -62,7 +67,7 @@ namespace lve {
 
 		void createShadowMap(LvePointShadowRenderer& shadowRenderer, LveDevice& device, VkExtent2D shadowExtent)
 		{
-			shadowMap = std::make_unique<ShadowMap>(device, shadowExtent);
+			shadowMap = std::make_shared<ShadowMap>(device, shadowExtent);
 			shadowRenderer.createFramebuffers(shadowMap->getImageView(), shadowMap->getExtent(), 1);
 		}
 
@@ -81,10 +86,7 @@ namespace lve {
 
 		void updateDescriptorSet(lve::LveDevice& device, VkDescriptorSet globalDescriptorSet) const
 		{
-			VkDescriptorImageInfo imageInfo;
-			imageInfo.imageView = shadowMap->getImageView();
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.sampler = shadowMap->getSampler();
+			VkDescriptorImageInfo imageInfo = shadowMap->descriptorInfo();
 
 			VkWriteDescriptorSet write{};
 			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
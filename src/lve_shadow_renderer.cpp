@@ -1,25 +1,28 @@
 #include "lve_shadow_renderer.h"
+#include "lve_pipeline_library.hpp"
 #include <array>
 #include <iostream>
 
 namespace lve {
-	LvePointShadowRenderer::LvePointShadowRenderer(LveDevice &device, const std::string &vertShaderPath, const std::string &fragShaderPath, VkDescriptorSetLayout globalSetLayout,
+	LvePointShadowRenderer::LvePointShadowRenderer(LveDevice &device, const std::string &vertShaderPath, const std::string &fragShaderPath, const LveDescriptorSetLayout &globalSetLayout,
 		std::vector<VkVertexInputBindingDescription> (*BindingDescriptions)(),
-		std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)()
+		std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)(),
+		LvePipelineBuildQueue *buildQueue
 		) :
 	device(device)
 	{
 		createRenderPass();
 		createPipelineLayout(globalSetLayout);
-		createPipeline(vertShaderPath, fragShaderPath);
+		createPipeline(vertShaderPath, fragShaderPath, buildQueue);
 	}
 
 	LvePointShadowRenderer::~LvePointShadowRenderer()
 	{
+		// a build still running reads the render pass
+		if (pendingPipeline.valid()) pendingPipeline.wait();
 		for (auto f : framebuffers)
 			vkDestroyFramebuffer(device.device(), f.second, nullptr);
 		vkDestroyRenderPass(device.device(), renderPass, nullptr);
-		vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
 	}
 
 	VkFramebuffer LvePointShadowRenderer::createFramebuffers(VkImageView imageView, VkExtent2D extent, uint32_t layers)
@@ -117,38 +120,36 @@ namespace lve {
 		{
 			throw std::runtime_error("failed to create shadow map render pass!");
 		}
+		device.pipelineLibrary().registerRenderPass(renderPass, rpInfo);
 	}
 
 
-	void LvePointShadowRenderer::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	void LvePointShadowRenderer::createPipelineLayout(const LveDescriptorSetLayout &globalSetLayout)
 	{
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
-			VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
+		pipelineLayout = device.pipelineLibrary().getPipelineLayout({&globalSetLayout});
 	}
 
-	void LvePointShadowRenderer::createPipeline(const std::string &vertShaderPath, const std::string &fragShaderPath)
+	void LvePointShadowRenderer::createPipeline(const std::string &vertShaderPath, const std::string &fragShaderPath,
+												LvePipelineBuildQueue *buildQueue)
 	{
-		PipelineConfigInfo pipelineConfig{};
-		LvePipeline::shadowPipelineConfigInfo(pipelineConfig);
+		auto configure = [renderPass = renderPass, layout = pipelineLayout](PipelineConfigInfo &pipelineConfig) {
+			LvePipeline::shadowPipelineConfigInfo(pipelineConfig);
+			pipelineConfig.renderPass = renderPass;
+			pipelineConfig.pipelineLayout = layout;
+		};
 
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
+		if (buildQueue)
+		{
+			pendingPipeline = buildQueue->submit({
+				vertShaderPath, fragShaderPath, configure,
+				RenderBucket::getBindingDescriptionsShadow, RenderBucket::getAttributeDescriptionsShadow
+			});
+			return;
+		}
 
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		pipeline = std::make_unique<LvePipeline>(
-			device,
+		PipelineConfigInfo pipelineConfig{};
+		configure(pipelineConfig);
+		pipeline = &device.pipelineLibrary().get(
 			vertShaderPath,
 			fragShaderPath,
 			pipelineConfig,
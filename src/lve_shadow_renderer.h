@@ -1,6 +1,8 @@
 #pragma once
+#include "lve_descriptors.hpp"
 #include "lve_device.hpp"
 #include "lve_pipeline.hpp"
+#include "lve_pipeline_build_queue.hpp"
 
 #include <memory>
 #include <unordered_map>
@@ -22,9 +24,10 @@ namespace lve {
 
 	class LvePointShadowRenderer {
 	public:
-		LvePointShadowRenderer(LveDevice &device, const std::string &vertShaderPath, const std::string &fragShaderPath, VkDescriptorSetLayout globalSetLayout,
+		LvePointShadowRenderer(LveDevice &device, const std::string &vertShaderPath, const std::string &fragShaderPath, const LveDescriptorSetLayout &globalSetLayout,
 			std::vector<VkVertexInputBindingDescription> (*BindingDescriptions)(),
-			std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)()
+			std::vector<VkVertexInputAttributeDescription> (*AttributeDescriptions)(),
+			LvePipelineBuildQueue *buildQueue = nullptr
 			);
 
 		~LvePointShadowRenderer();
@@ -36,6 +39,9 @@ namespace lve {
 		VkFramebuffer createFramebuffers(VkImageView imageView, VkExtent2D extent, uint32_t layers);
 		VkFramebuffer getFramebuffer(VkExtent2D extent);
 
+		// takes the pipeline submitted to the build queue, call it once the queue's wait returned
+		void collectPipeline() { pipeline = pendingPipeline.get(); }
+
 		VkPipelineLayout getPipelineLayout() { return pipelineLayout; }
 		VkPipeline getPipeline() { return pipeline->getPipeline(); }
 		VkRenderPass getRenderPass() { return renderPass; }
@@ -48,9 +54,10 @@ namespace lve {
 	private:
 		void createRenderPass();
 
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+		void createPipelineLayout(const LveDescriptorSetLayout &globalSetLayout);
 
-		void createPipeline(const std::string &vertShaderPath, const std::string &fragShaderPath);
+		void createPipeline(const std::string &vertShaderPath, const std::string &fragShaderPath,
+							LvePipelineBuildQueue *buildQueue);
 
 		// framebuffer held by resolution with ShadowMapSize
 		std::unordered_map<VkExtent2D, VkFramebuffer, Extent2DHash, Extent2DEqual> framebuffers;
@@ -59,8 +66,9 @@ namespace lve {
 		VkRenderPass renderPass;
 
 		// pipeline stuff
-		std::unique_ptr<LvePipeline> pipeline;
-		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		LvePipeline *pipeline = nullptr; // owned by the device's pipeline library
+		std::future<LvePipeline *> pendingPipeline;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE; // owned by the device's pipeline library
 
 		LveDevice &device;
 	};
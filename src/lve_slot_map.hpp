@@ -0,0 +1,302 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace lve {
+	struct Handle {
+		uint32_t index;
+		uint32_t generation;
+	};
+
+	struct NoCold {};
+
+	// generational slot map, hot payload is stored apart from cold payload so iteration only pulls
+	// in what it touches. handles point into a slot table that points into the dense payload arrays,
+	// so compact() can move payloads around without invalidating handles.
+	// liveness of the dense arrays is one bit per entry, packed into 64 bit words
+	template<typename Hot, typename Cold = NoCold>
+	class LveSlotMap {
+	public:
+		Handle insert(const Hot &hotValue, const Cold &coldValue = {})
+		{
+			uint32_t slot = acquireSlot();
+			uint32_t dense = acquireDense();
+			place(slot, dense, hotValue, coldValue);
+			return Handle{slot, slots[slot].generation};
+		}
+
+		// cold may be empty, out must hold one handle per hot value
+		void insert(std::span<const Hot> hotValues, std::span<const Cold> coldValues, std::span<Handle> out)
+		{
+			assert(out.size() >= hotValues.size() && "not enough room for the handles");
+			assert((coldValues.empty() || coldValues.size() == hotValues.size()) && "cold and hot count differ");
+
+			// grow every array once for whatever the free lists can't cover
+			size_t newSlots = hotValues.size() - std::min(hotValues.size(), freeSlots.size());
+			size_t newDense = hotValues.size() - std::min(hotValues.size(), freeDense.size());
+			slots.reserve(slots.size() + newSlots);
+			growDense(hot.size() + newDense);
+			size_t appendAt = hot.size() - newDense;
+
+			for (size_t i = 0; i < hotValues.size(); i++)
+			{
+				uint32_t slot = acquireSlot();
+				uint32_t dense;
+				if (!freeDense.empty())
+				{
+					dense = freeDense.back();
+					freeDense.pop_back();
+				} else
+					dense = static_cast<uint32_t>(appendAt++);
+
+				place(slot, dense, hotValues[i], coldValues.empty() ? Cold{} : coldValues[i]);
+				out[i] = Handle{slot, slots[slot].generation};
+			}
+		}
+
+		bool erase(Handle h)
+		{
+			if (!contains(h)) return false;
+
+			Slot &slot = slots[h.index];
+			alive[slot.dense >> 6] &= ~(uint64_t{1} << (slot.dense & 63));
+			freeDense.push_back(slot.dense);
+
+			slot.generation++; // invalidates every handle to this slot
+			slot.dense = INVALID;
+			freeSlots.push_back(h.index);
+			aliveCount--;
+			return true;
+		}
+
+		void erase(std::span<const Handle> handles)
+		{
+			freeSlots.reserve(freeSlots.size() + handles.size());
+			freeDense.reserve(freeDense.size() + handles.size());
+			for (const Handle &h: handles)
+				erase(h);
+		}
+
+		void clear()
+		{
+			// keep the slot table so old handles stay stale
+			for (uint32_t i = 0; i < slots.size(); i++)
+			{
+				if (slots[i].dense == INVALID) continue;
+				slots[i].generation++;
+				slots[i].dense = INVALID;
+				freeSlots.push_back(i);
+			}
+			hot.clear();
+			cold.clear();
+			denseToSlot.clear();
+			alive.clear();
+			freeDense.clear();
+			aliveCount = 0;
+		}
+
+		// moves live entries from the back into holes at the front, at most maxMoves per call.
+		// once nothing is left to move the dense arrays are cut to the live count and shrunk.
+		// returns true when the storage is dense
+		bool compact(uint32_t maxMoves = ~0u)
+		{
+			uint32_t dst = nextHole(0);
+			uint32_t src = prevLive(capacity());
+			uint32_t moves = 0;
+
+			while (dst < src && moves < maxMoves)
+			{
+				move(src, dst);
+				moves++;
+				dst = nextHole(dst + 1);
+				src = prevLive(src);
+			}
+
+			if (dst < src)
+			{
+				// budget ran out, moved entries left holes behind that the free list doesn't know yet
+				rebuildFreeDense();
+				return false;
+			}
+
+			growDense(aliveCount);
+			hot.shrink_to_fit();
+			cold.shrink_to_fit();
+			denseToSlot.shrink_to_fit();
+			alive.shrink_to_fit();
+			freeDense.clear();
+			return true;
+		}
+
+		bool contains(Handle h) const
+		{
+			return h.index < slots.size() && slots[h.index].generation == h.generation &&
+					slots[h.index].dense != INVALID;
+		}
+
+		Hot *get(Handle h) { return contains(h) ? &hot[slots[h.index].dense] : nullptr; }
+		const Hot *get(Handle h) const { return contains(h) ? &hot[slots[h.index].dense] : nullptr; }
+		Cold *getCold(Handle h) { return contains(h) ? &cold[slots[h.index].dense] : nullptr; }
+		const Cold *getCold(Handle h) const { return contains(h) ? &cold[slots[h.index].dense] : nullptr; }
+
+		// calls fn(denseIndex, hot) for every live entry in dense order, dead words are skipped whole
+		template<typename Fn>
+		void forEach(Fn &&fn)
+		{
+			forEachIndex([&](uint32_t index) { fn(index, hot[index]); });
+		}
+
+		template<typename Fn>
+		void forEach(Fn &&fn) const
+		{
+			forEachIndex([&](uint32_t index) { fn(index, hot[index]); });
+		}
+
+		template<typename Fn>
+		void forEachIndex(Fn &&fn) const
+		{
+			for (size_t word = 0; word < alive.size(); word++)
+			{
+				uint64_t bits = alive[word];
+				while (bits)
+				{
+					fn(static_cast<uint32_t>(word * 64 + std::countr_zero(bits)));
+					bits &= bits - 1;
+				}
+			}
+		}
+
+		// where the payload of h currently sits, ~0u for stale handles. only valid until the next compact
+		uint32_t denseIndex(Handle h) const { return contains(h) ? slots[h.index].dense : INVALID; }
+
+		Handle handleAt(uint32_t denseIndex) const
+		{
+			uint32_t slot = denseToSlot[denseIndex];
+			return Handle{slot, slots[slot].generation};
+		}
+
+		bool isAlive(uint32_t denseIndex) const { return (alive[denseIndex >> 6] >> (denseIndex & 63)) & 1; }
+		uint32_t size() const { return aliveCount; }
+		uint32_t capacity() const { return static_cast<uint32_t>(hot.size()); }
+		uint32_t holeCount() const { return capacity() - aliveCount; }
+
+		std::span<Hot> hotData() { return hot; }
+		std::span<const Hot> hotData() const { return hot; }
+		std::span<Cold> coldData() { return cold; }
+		std::span<const uint64_t> aliveWords() const { return alive; }
+
+	private:
+		static constexpr uint32_t INVALID = ~0u;
+
+		struct Slot {
+			uint32_t dense = INVALID; // INVALID while the slot is free
+			uint32_t generation = 0; // how many times the slot has been reused
+		};
+
+		uint32_t acquireSlot()
+		{
+			if (freeSlots.empty())
+			{
+				slots.push_back({});
+				return static_cast<uint32_t>(slots.size() - 1);
+			}
+			uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+
+		uint32_t acquireDense()
+		{
+			if (freeDense.empty())
+			{
+				growDense(hot.size() + 1);
+				return static_cast<uint32_t>(hot.size() - 1);
+			}
+			uint32_t dense = freeDense.back();
+			freeDense.pop_back();
+			return dense;
+		}
+
+		void place(uint32_t slot, uint32_t dense, const Hot &hotValue, const Cold &coldValue)
+		{
+			hot[dense] = hotValue;
+			cold[dense] = coldValue;
+			denseToSlot[dense] = slot;
+			slots[slot].dense = dense;
+			alive[dense >> 6] |= uint64_t{1} << (dense & 63);
+			aliveCount++;
+		}
+
+		void move(uint32_t src, uint32_t dst)
+		{
+			hot[dst] = std::move(hot[src]);
+			cold[dst] = std::move(cold[src]);
+			denseToSlot[dst] = denseToSlot[src];
+			slots[denseToSlot[dst]].dense = dst;
+
+			alive[dst >> 6] |= uint64_t{1} << (dst & 63);
+			alive[src >> 6] &= ~(uint64_t{1} << (src & 63));
+		}
+
+		void growDense(size_t count)
+		{
+			hot.resize(count);
+			cold.resize(count);
+			denseToSlot.resize(count, INVALID);
+			alive.resize((count + 63) / 64, 0);
+			// bits past the end of a shrunk array must not read as alive
+			if (count & 63) alive.back() &= (uint64_t{1} << (count & 63)) - 1;
+		}
+
+		// first dead entry at or after begin, capacity() if there is none
+		uint32_t nextHole(uint32_t begin) const
+		{
+			uint32_t end = capacity();
+			for (uint32_t word = begin >> 6; word < alive.size(); word++)
+			{
+				uint64_t dead = ~alive[word];
+				if (word == begin >> 6) dead &= ~uint64_t{0} << (begin & 63);
+				if (dead) return std::min(end, static_cast<uint32_t>(word * 64 + std::countr_zero(dead)));
+			}
+			return end;
+		}
+
+		// last live entry before end, 0 if there is none (0 is never a valid move source anyway)
+		uint32_t prevLive(uint32_t end) const
+		{
+			if (end == 0) return 0;
+			for (uint32_t word = ((end - 1) >> 6) + 1; word-- > 0;)
+			{
+				uint64_t bits = alive[word];
+				if (word == (end - 1) >> 6 && ((end - 1) & 63) != 63)
+					bits &= (uint64_t{1} << (((end - 1) & 63) + 1)) - 1;
+				if (bits) return static_cast<uint32_t>(word * 64 + 63 - std::countl_zero(bits));
+			}
+			return 0;
+		}
+
+		void rebuildFreeDense()
+		{
+			// descending, so the lowest hole is handed out first and the prefix stays dense
+			freeDense.clear();
+			for (uint32_t i = capacity(); i-- > 0;)
+				if (!isAlive(i)) freeDense.push_back(i);
+		}
+
+		std::vector<Slot> slots;
+		std::vector<uint32_t> freeSlots;
+
+		std::vector<Hot> hot;
+		std::vector<Cold> cold;
+		std::vector<uint32_t> denseToSlot;
+		std::vector<uint64_t> alive; // bit per dense entry
+		std::vector<uint32_t> freeDense;
+		uint32_t aliveCount = 0;
+	};
+} // namespace lve
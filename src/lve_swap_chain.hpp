@@ -13,12 +13,16 @@
 namespace lve {
 	class LveSwapChain {
 	public:
-		static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+		// upper bound, per frame resources are sized for it. how many are actually used is up to LveRenderer
+		static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
 
-		LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent);
+		// falls back to mailbox, then immediate, then fifo when the preferred mode is not supported
+		LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent,
+					VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR);
 
 		LveSwapChain(
-			LveDevice &deviceRef, VkExtent2D windowExtent, std::shared_ptr<LveSwapChain> previous);
+			LveDevice &deviceRef, VkExtent2D windowExtent, std::shared_ptr<LveSwapChain> previous,
+			VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR);
 
 		~LveSwapChain();
 
@@ -35,6 +39,7 @@ namespace lve {
 		uint32_t width() { return swapChainExtent.width; }
 		uint32_t height() { return swapChainExtent.height; }
 		VkSwapchainKHR getSwapChain() { return swapChain; }
+		VkPresentModeKHR getPresentMode() const { return presentMode; }
 
 		float extentAspectRatio()
 		{
@@ -45,7 +50,9 @@ namespace lve {
 
 		VkResult acquireNextImage(uint32_t *imageIndex);
 
-		VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+		// frameTimeline is signalled to frameValue once the buffers have executed
+		VkResult submitCommandBuffers(
+			const VkCommandBuffer *buffers, uint32_t *imageIndex, VkSemaphore frameTimeline, uint64_t frameValue);
 
 		bool compareSwapFormats(const LveSwapChain &swapChain) const
 		{
@@ -68,6 +75,8 @@ namespace lve {
 
 		void createSyncObjects();
 
+		void waitForFrameValue(uint64_t value);
+
 		// Helper functions
 		VkSurfaceFormatKHR chooseSwapSurfaceFormat(
 			const std::vector<VkSurfaceFormatKHR> &availableFormats);
@@ -77,6 +86,8 @@ namespace lve {
 
 		VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
+		VkPresentModeKHR preferredPresentMode;
+		VkPresentModeKHR presentMode;
 		VkFormat swapChainImageFormat;
 		VkFormat swapChainDepthFormat;
 		VkExtent2D swapChainExtent;
@@ -85,7 +96,7 @@ namespace lve {
 		VkRenderPass renderPass;
 
 		std::vector<VkImage> depthImages;
-		std::vector<VkDeviceMemory> depthImageMemorys;
+		std::vector<LveAllocation> depthImageAllocations;
 		std::vector<VkImageView> depthImageViews;
 		std::vector<VkImage> swapChainImages;
 		std::vector<VkImageView> swapChainImageViews;
@@ -98,8 +109,10 @@ namespace lve {
 
 		std::vector<VkSemaphore> imageAvailableSemaphores;
 		std::vector<VkSemaphore> renderFinishedSemaphores;
-		std::vector<VkFence> inFlightFences;
-		std::vector<VkFence> imagesInFlight;
+		// frame timeline values, 0 for nothing submitted yet
+		VkSemaphore frameTimeline = VK_NULL_HANDLE;
+		std::vector<uint64_t> inFlightValues;
+		std::vector<uint64_t> imagesInFlight;
 		size_t currentFrame = 0;
 	};
 } // namespace lve
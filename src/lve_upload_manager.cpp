@@ -0,0 +1,462 @@
+#include "lve_upload_manager.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+	// satisfies the 4 byte and texel size rules of buffer to image copies for every format we upload
+	static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	LveUploadManager::LveUploadManager(LveDevice &device, VkDeviceSize ringSize, VkDeviceSize assetRingSize)
+		: lveDevice{device}
+	{
+		QueueFamilyIndices indices = lveDevice.findPhysicalQueueFamilies();
+		createLane(frame, lveDevice.graphicsQueue(), indices.graphicsFamily, VK_NULL_HANDLE, ringSize);
+
+		async = lveDevice.hasDedicatedTransferQueue();
+		if (async)
+			createLane(asset, lveDevice.transferQueue(), indices.transferFamily, lveDevice.getTransferCommandPool(),
+						assetRingSize);
+	}
+
+	LveUploadManager::~LveUploadManager()
+	{
+		{
+			std::lock_guard lock{mutex};
+			flushLocked();
+			waitLocked(frame, frame.submittedValue);
+			if (async) waitLocked(asset, asset.submittedValue);
+		}
+		destroyLane(frame);
+		if (async) destroyLane(asset);
+	}
+
+	void LveUploadManager::uploadBuffer(VkBuffer dst, const void *data, VkDeviceSize size, VkDeviceSize dstOffset)
+	{
+		if (size == 0) return;
+		std::lock_guard lock{mutex};
+		copyBuffer(frame, dst, data, size, dstOffset);
+	}
+
+	void LveUploadManager::uploadImage(VkImage dst, const void *data, VkDeviceSize size, VkExtent3D extent,
+										VkImageLayout finalLayout, VkImageAspectFlags aspect)
+	{
+		std::lock_guard lock{mutex};
+		VkCommandBuffer commandBuffer = copyImage(frame, dst, data, size, extent, aspect);
+
+		// the closing barrier of the batch only covers memory, the layout change needs its own
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = dst;
+		barrier.subresourceRange = {aspect, 0, 1, 0, 1};
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = finalLayout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+							0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void LveUploadManager::uploadAsset(VkBuffer dst, const void *data, VkDeviceSize size)
+	{
+		if (!async)
+		{
+			uploadBuffer(dst, data, size);
+			return;
+		}
+		if (size == 0) return;
+		std::lock_guard lock{mutex};
+		VkCommandBuffer commandBuffer = copyBuffer(asset, dst, data, size, 0);
+
+		// release from the transfer family, the matching acquire goes into the next graphics batch
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = asset.family;
+		barrier.dstQueueFamilyIndex = frame.family;
+		barrier.buffer = dst;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+							0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		// the release sits in the open asset batch, which gets the next timeline value
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		pendingBufferAcquires.push_back({barrier, asset.submittedValue + 1});
+	}
+
+	void LveUploadManager::uploadAsset(VkImage dst, const void *data, VkDeviceSize size, VkExtent3D extent,
+										VkImageLayout finalLayout, VkImageAspectFlags aspect)
+	{
+		if (!async)
+		{
+			uploadImage(dst, data, size, extent, finalLayout, aspect);
+			return;
+		}
+		std::lock_guard lock{mutex};
+		VkCommandBuffer commandBuffer = copyImage(asset, dst, data, size, extent, aspect);
+
+		// the layout change is part of the transfer, release and acquire have to name the same layouts
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = asset.family;
+		barrier.dstQueueFamilyIndex = frame.family;
+		barrier.image = dst;
+		barrier.subresourceRange = {aspect, 0, 1, 0, 1};
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = finalLayout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+							0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		pendingImageAcquires.push_back({barrier, asset.submittedValue + 1});
+	}
+
+	uint64_t LveUploadManager::flush()
+	{
+		std::lock_guard lock{mutex};
+		return flushLocked();
+	}
+
+	uint64_t LveUploadManager::finishAssets()
+	{
+		std::lock_guard lock{mutex};
+		flushLocked();
+		if (async) waitLocked(asset, asset.submittedValue);
+		return flushLocked();
+	}
+
+	bool LveUploadManager::hasPendingWork()
+	{
+		std::lock_guard lock{mutex};
+		return frame.recording || asset.recording || !pendingBufferAcquires.empty() || !pendingImageAcquires.empty();
+	}
+
+	bool LveUploadManager::isComplete(uint64_t value)
+	{
+		uint64_t completed = 0;
+		vkGetSemaphoreCounterValue(lveDevice.device(), frame.timeline, &completed);
+		return completed >= value;
+	}
+
+	void LveUploadManager::wait(uint64_t value)
+	{
+		std::lock_guard lock{mutex};
+		waitLocked(frame, value);
+	}
+
+	void LveUploadManager::createLane(Lane &lane, VkQueue queue, uint32_t family, VkCommandPool pool,
+									VkDeviceSize ringSize)
+	{
+		lane.queue = queue;
+		lane.family = family;
+		lane.ringSize = ringSize;
+
+		lane.ring = std::make_unique<LveBuffer>(
+			lveDevice, ringSize, 1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		lane.ring->map();
+
+		lane.commandPool = pool;
+		if (lane.commandPool == VK_NULL_HANDLE)
+		{
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = family;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &lane.commandPool) != VK_SUCCESS)
+				throw std::runtime_error("failed to create upload command pool!");
+			lane.ownsPool = true;
+		}
+
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		if (vkCreateSemaphore(lveDevice.device(), &semaphoreInfo, nullptr, &lane.timeline) != VK_SUCCESS)
+			throw std::runtime_error("failed to create upload timeline semaphore!");
+	}
+
+	void LveUploadManager::destroyLane(Lane &lane)
+	{
+		vkDestroySemaphore(lveDevice.device(), lane.timeline, nullptr);
+		if (lane.ownsPool)
+			vkDestroyCommandPool(lveDevice.device(), lane.commandPool, nullptr);
+		else if (!lane.freeCommandBuffers.empty())
+			vkFreeCommandBuffers(lveDevice.device(), lane.commandPool,
+								static_cast<uint32_t>(lane.freeCommandBuffers.size()), lane.freeCommandBuffers.data());
+		lane.ring.reset();
+	}
+
+	VkCommandBuffer LveUploadManager::copyBuffer(Lane &lane, VkBuffer dst, const void *data, VkDeviceSize size,
+												VkDeviceSize dstOffset)
+	{
+		VkBuffer src;
+		VkDeviceSize srcOffset;
+		std::memcpy(stage(lane, size, src, srcOffset), data, size);
+
+		VkBufferCopy region{};
+		region.srcOffset = srcOffset;
+		region.dstOffset = dstOffset;
+		region.size = size;
+		VkCommandBuffer commandBuffer = record(lane);
+		vkCmdCopyBuffer(commandBuffer, src, dst, 1, &region);
+		return commandBuffer;
+	}
+
+	VkCommandBuffer LveUploadManager::copyImage(Lane &lane, VkImage dst, const void *data, VkDeviceSize size,
+												VkExtent3D extent, VkImageAspectFlags aspect)
+	{
+		VkBuffer src;
+		VkDeviceSize srcOffset;
+		std::memcpy(stage(lane, size, src, srcOffset), data, size);
+		VkCommandBuffer commandBuffer = record(lane);
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = dst;
+		barrier.subresourceRange = {aspect, 0, 1, 0, 1};
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+							0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = srcOffset;
+		region.imageSubresource = {aspect, 0, 0, 1};
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = extent;
+		vkCmdCopyBufferToImage(commandBuffer, src, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		return commandBuffer;
+	}
+
+	void *LveUploadManager::stage(Lane &lane, VkDeviceSize size, VkBuffer &buffer, VkDeviceSize &offset)
+	{
+		// would never fit, gets a buffer of its own that lives as long as the batch
+		if (size + STAGING_ALIGNMENT > lane.ringSize)
+			return stageOverflow(lane, size, buffer, offset);
+
+		while (!reserveRing(lane, size, offset))
+		{
+			// full. uploads come from any thread and the graphics queue belongs to the thread submitting
+			// frames, so nothing is submitted here, only batches flush() already sent can give space back
+			if (lane.inFlight.empty())
+				return stageOverflow(lane, size, buffer, offset);
+			waitLocked(lane, lane.inFlight.front().value);
+		}
+		buffer = lane.ring->getBuffer();
+		return static_cast<char *>(lane.ring->getMappedMemory()) + offset;
+	}
+
+	void *LveUploadManager::stageOverflow(Lane &lane, VkDeviceSize size, VkBuffer &buffer, VkDeviceSize &offset)
+	{
+		auto staging = std::make_unique<LveBuffer>(
+			lveDevice, size, 1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			1, AllocationStrategy::linear);
+		staging->map();
+		buffer = staging->getBuffer();
+		offset = 0;
+		void *mapped = staging->getMappedMemory();
+		lane.open.overflow.push_back(std::move(staging));
+		return mapped;
+	}
+
+	bool LveUploadManager::reserveRing(Lane &lane, VkDeviceSize size, VkDeviceSize &offset)
+	{
+		if (lane.used == 0) lane.head = lane.tail = 0;
+
+		VkDeviceSize start = (lane.head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+		if (lane.head >= lane.tail && lane.used < lane.ringSize)
+		{
+			// free space is the end of the ring and the front up to tail
+			if (start + size <= lane.ringSize)
+				offset = start;
+			else if (size <= lane.tail)
+				offset = 0;
+			else
+				return false;
+		} else if (lane.head < lane.tail && start + size <= lane.tail)
+			offset = start;
+		else
+			return false;
+
+		VkDeviceSize consumed = offset >= lane.head
+									? offset + size - lane.head
+									: lane.ringSize - lane.head + offset + size;
+		lane.used += consumed;
+		lane.open.ringBytes += consumed;
+		lane.head = offset + size;
+		return true;
+	}
+
+	VkCommandBuffer LveUploadManager::record(Lane &lane)
+	{
+		if (lane.recording) return lane.open.commandBuffer;
+
+		retire(lane);
+		if (lane.freeCommandBuffers.empty())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = lane.commandPool;
+			allocInfo.commandBufferCount = 1;
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("failed to allocate upload command buffer!");
+			lane.freeCommandBuffers.push_back(commandBuffer);
+		}
+		lane.open.commandBuffer = lane.freeCommandBuffers.back();
+		lane.freeCommandBuffers.pop_back();
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(lane.open.commandBuffer, &beginInfo);
+
+		// frames submitted earlier may still read what this batch overwrites
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(lane.open.commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+							VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		lane.recording = true;
+		return lane.open.commandBuffer;
+	}
+
+	// moves the acquires whose release has executed to out and returns the newest asset value among them
+	template<typename Pending, typename Barrier>
+	static uint64_t takeReady(std::deque<Pending> &pending, uint64_t completed, std::vector<Barrier> &out)
+	{
+		uint64_t value = 0;
+		while (!pending.empty() && pending.front().assetValue <= completed)
+		{
+			out.push_back(pending.front().barrier);
+			value = pending.front().assetValue;
+			pending.pop_front();
+		}
+		return value;
+	}
+
+	uint64_t LveUploadManager::flushLocked()
+	{
+		if (!async) return submitLocked(frame, 0);
+
+		submitLocked(asset, 0);
+		uint64_t completed = 0;
+		vkGetSemaphoreCounterValue(lveDevice.device(), asset.timeline, &completed);
+
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+		uint64_t assetValue = std::max(takeReady(pendingBufferAcquires, completed, bufferAcquires),
+										takeReady(pendingImageAcquires, completed, imageAcquires));
+		if (bufferAcquires.empty() && imageAcquires.empty())
+			return submitLocked(frame, 0);
+
+		vkCmdPipelineBarrier(record(frame), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+							0, 0, nullptr,
+							static_cast<uint32_t>(bufferAcquires.size()), bufferAcquires.data(),
+							static_cast<uint32_t>(imageAcquires.size()), imageAcquires.data());
+		// the value is already reached, the wait costs nothing but orders the release before the acquire
+		return submitLocked(frame, assetValue);
+	}
+
+	uint64_t LveUploadManager::submitLocked(Lane &lane, uint64_t waitValue)
+	{
+		if (!lane.recording) return lane.submittedValue;
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(lane.open.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+							VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		vkEndCommandBuffer(lane.open.commandBuffer);
+
+		lane.open.value = lane.submittedValue + 1;
+		lane.open.ringEnd = lane.head;
+
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &lane.open.value;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &lane.open.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &lane.timeline;
+		if (waitValue != 0)
+		{
+			timelineInfo.waitSemaphoreValueCount = 1;
+			timelineInfo.pWaitSemaphoreValues = &waitValue;
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &asset.timeline;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+
+		if (vkQueueSubmit(lane.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			throw std::runtime_error("failed to submit upload batch!");
+
+		lane.submittedValue = lane.open.value;
+		lane.inFlight.push_back(std::move(lane.open));
+		lane.open = Batch{};
+		lane.recording = false;
+		return lane.submittedValue;
+	}
+
+	void LveUploadManager::waitLocked(Lane &lane, uint64_t value)
+	{
+		if (value == 0) return;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &lane.timeline;
+		waitInfo.pValues = &value;
+		vkWaitSemaphores(lveDevice.device(), &waitInfo, UINT64_MAX);
+		retire(lane);
+	}
+
+	void LveUploadManager::retire(Lane &lane)
+	{
+		uint64_t completed = 0;
+		vkGetSemaphoreCounterValue(lveDevice.device(), lane.timeline, &completed);
+
+		while (!lane.inFlight.empty() && lane.inFlight.front().value <= completed)
+		{
+			Batch &batch = lane.inFlight.front();
+			lane.tail = batch.ringEnd;
+			lane.used -= batch.ringBytes;
+			vkResetCommandBuffer(batch.commandBuffer, 0);
+			lane.freeCommandBuffers.push_back(batch.commandBuffer);
+			lane.inFlight.pop_front();
+		}
+	}
+} // namespace lve
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+
+// std
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lve {
+	// batches staging copies into a single submit. data is copied into a persistently mapped ring right away,
+	// the copy commands collect in the open batch until flush() submits it and returns the timeline value
+	// that gets signalled once it has executed.
+	// every batch starts and ends with a full barrier, so graphics work submitted before a flush never sees
+	// the new data and work submitted after always does, without any cpu wait.
+	// the upload calls are thread safe and never submit, only flush() does.
+	// uploads come in two lanes. uploadBuffer() is for data the next frame reads and always goes through the
+	// graphics queue. uploadAsset() is for new meshes and textures, on a device with a dedicated transfer
+	// family those run on the transfer queue next to rendering and get handed to the graphics family by a
+	// release/acquire barrier pair, otherwise they fall back to the graphics lane
+	class LveUploadManager {
+	public:
+		explicit LveUploadManager(LveDevice &device, VkDeviceSize ringSize = 32ull << 20,
+								VkDeviceSize assetRingSize = 64ull << 20);
+		~LveUploadManager();
+
+		LveUploadManager(const LveUploadManager &) = delete;
+		LveUploadManager &operator=(const LveUploadManager &) = delete;
+
+		void uploadBuffer(VkBuffer dst, const void *data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+		// mip 0 and layer 0 of an image in undefined layout, which ends up in finalLayout
+		void uploadImage(VkImage dst, const void *data, VkDeviceSize size, VkExtent3D extent,
+						VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+						VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+
+		// dst must not be in use by the gpu yet, the whole buffer changes queue family ownership
+		void uploadAsset(VkBuffer dst, const void *data, VkDeviceSize size);
+		void uploadAsset(VkImage dst, const void *data, VkDeviceSize size, VkExtent3D extent,
+						VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+						VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+
+		// submits the asset lane, then the graphics lane with the ownership acquires of the assets whose
+		// transfer has already finished. the others stay queued for a later flush, so a frame never waits
+		// on an asset copy. an asset is safe to draw once a flush has taken its acquire.
+		// only call it from the thread that submits frames.
+		// returns the graphics timeline value of the last submitted batch when nothing new was recorded
+		uint64_t flush();
+		// blocks until every asset uploaded so far has landed, then flushes its acquire. for loading
+		uint64_t finishAssets();
+		bool isComplete(uint64_t value);
+		void wait(uint64_t value);
+		VkSemaphore getTimeline() const { return frame.timeline; }
+		bool isAsync() const { return async; }
+		// something was recorded that the next flush still has to submit
+		bool hasPendingWork();
+
+	private:
+		struct Batch {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			uint64_t value = 0; // timeline value that marks it done
+			VkDeviceSize ringEnd = 0; // ring head when the batch was closed
+			VkDeviceSize ringBytes = 0; // ring space it holds, wrap around gaps included
+			std::vector<std::unique_ptr<LveBuffer> > overflow; // uploads too big for the ring
+		};
+
+		// one queue with its own staging ring, command buffers and timeline
+		struct Lane {
+			VkQueue queue = VK_NULL_HANDLE;
+			uint32_t family = 0;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			bool ownsPool = false;
+			std::vector<VkCommandBuffer> freeCommandBuffers;
+			VkSemaphore timeline = VK_NULL_HANDLE;
+			uint64_t submittedValue = 0;
+
+			std::unique_ptr<LveBuffer> ring;
+			VkDeviceSize ringSize = 0;
+			VkDeviceSize head = 0; // next write
+			VkDeviceSize tail = 0; // oldest byte a batch still reads
+			VkDeviceSize used = 0;
+
+			Batch open;
+			bool recording = false;
+			std::deque<Batch> inFlight;
+		};
+
+		void createLane(Lane &lane, VkQueue queue, uint32_t family, VkCommandPool pool, VkDeviceSize ringSize);
+		void destroyLane(Lane &lane);
+		VkCommandBuffer copyBuffer(Lane &lane, VkBuffer dst, const void *data, VkDeviceSize size,
+									VkDeviceSize dstOffset);
+		// leaves the image in transfer dst layout, the caller records where it goes from there
+		VkCommandBuffer copyImage(Lane &lane, VkImage dst, const void *data, VkDeviceSize size, VkExtent3D extent,
+								VkImageAspectFlags aspect);
+
+		// reserves size bytes of staging memory, waits for submitted batches when the ring is full and
+		// falls back to a buffer of its own when the open batch holds all of it
+		void *stage(Lane &lane, VkDeviceSize size, VkBuffer &buffer, VkDeviceSize &offset);
+		void *stageOverflow(Lane &lane, VkDeviceSize size, VkBuffer &buffer, VkDeviceSize &offset);
+		bool reserveRing(Lane &lane, VkDeviceSize size, VkDeviceSize &offset);
+		VkCommandBuffer record(Lane &lane);
+		uint64_t flushLocked();
+		// waitValue is an asset timeline value the batch has to wait for, 0 for none
+		uint64_t submitLocked(Lane &lane, uint64_t waitValue);
+		void waitLocked(Lane &lane, uint64_t value);
+		void retire(Lane &lane);
+
+		LveDevice &lveDevice;
+		std::mutex mutex;
+		bool async = false;
+
+		Lane frame;
+		Lane asset;
+
+		// acquire half of an ownership transfer, recorded into the first graphics batch flushed after the
+		// asset timeline reached the value of the batch holding the release
+		template<typename Barrier>
+		struct PendingAcquire {
+			Barrier barrier;
+			uint64_t assetValue = 0;
+		};
+
+		// in release order, so the ones that are ready are always at the front
+		std::deque<PendingAcquire<VkBufferMemoryBarrier> > pendingBufferAcquires;
+		std::deque<PendingAcquire<VkImageMemoryBarrier> > pendingImageAcquires;
+	};
+} // namespace lve
@@ -22,6 +22,13 @@ void LveWindow::initWindow() {
   window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
   glfwSetWindowUserPointer(window, this);
   glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+  glfwSetKeyCallback(window, keyCallback);
+  glfwSetCharCallback(window, charCallback);
+  glfwSetCursorPosCallback(window, cursorPosCallback);
+  glfwSetMouseButtonCallback(window, mouseButtonCallback);
+  glfwSetScrollCallback(window, scrollCallback);
+  glfwSetWindowFocusCallback(window, focusCallback);
+  glfwSetWindowRefreshCallback(window, refreshCallback);
 }
 
 void LveWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR *surface) {
@@ -35,6 +42,25 @@ void LveWindow::framebufferResizeCallback(GLFWwindow *window, int width, int hei
   lveWindow->framebufferResized = true;
   lveWindow->width = width;
   lveWindow->height = height;
+  lveWindow->eventCount++;
 }
 
+void LveWindow::countEvent(GLFWwindow *window) {
+  reinterpret_cast<LveWindow *>(glfwGetWindowUserPointer(window))->eventCount++;
+}
+
+void LveWindow::keyCallback(GLFWwindow *window, int, int, int, int) { countEvent(window); }
+
+void LveWindow::charCallback(GLFWwindow *window, unsigned int) { countEvent(window); }
+
+void LveWindow::cursorPosCallback(GLFWwindow *window, double, double) { countEvent(window); }
+
+void LveWindow::mouseButtonCallback(GLFWwindow *window, int, int, int) { countEvent(window); }
+
+void LveWindow::scrollCallback(GLFWwindow *window, double, double) { countEvent(window); }
+
+void LveWindow::focusCallback(GLFWwindow *window, int) { countEvent(window); }
+
+void LveWindow::refreshCallback(GLFWwindow *window) { countEvent(window); }
+
 }  // namespace lve
\ No newline at end of file
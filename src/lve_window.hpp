@@ -3,6 +3,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 #include <string>
 namespace lve {
 
@@ -24,13 +25,29 @@ public:
 
   void createWindowSurface(VkInstance instance, VkSurfaceKHR *surface);
 
+  // bumped by every input, resize and expose event, compare two reads to see if anything happened
+  uint64_t getEventCount() const { return eventCount; }
+  // makes a blocking glfwWaitEvents on the main thread return, callable from any thread
+  void wakeUp() { glfwPostEmptyEvent(); }
+
 private:
   static void framebufferResizeCallback(GLFWwindow *window, int width, int height);
+  // installed before imgui, which chains them from its own callbacks
+  static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+  static void charCallback(GLFWwindow *window, unsigned int codepoint);
+  static void cursorPosCallback(GLFWwindow *window, double x, double y);
+  static void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods);
+  static void scrollCallback(GLFWwindow *window, double x, double y);
+  static void focusCallback(GLFWwindow *window, int focused);
+  static void refreshCallback(GLFWwindow *window);
+  static void countEvent(GLFWwindow *window);
   void initWindow();
 
-  int width;
-  int height;
-  bool framebufferResized = false;
+  // written by glfw callbacks on the main thread, read by the render thread
+  std::atomic<int> width;
+  std::atomic<int> height;
+  std::atomic<bool> framebufferResized{false};
+  std::atomic<uint64_t> eventCount{0};
 
   std::string windowName;
   GLFWwindow *window;
@@ -3,11 +3,21 @@
 // std
 #include <cstdlib>
 #include <iostream>
+#include <cstring>
 #include <stdexcept>
 
-int main()
+int main(int argc, char **argv)
 {
 	lve::FirstApp app{};
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--threaded-render") == 0)
+			app.threadedRendering = true;
+		else if (std::strcmp(argv[i], "--idle") == 0)
+			app.idleRendering = true;
+		else if (std::strcmp(argv[i], "--hot-reload") == 0)
+			app.hotReloadShaders = true;
+	}
 
 	try
 	{
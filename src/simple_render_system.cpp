@@ -1,4 +1,5 @@
 #include "simple_render_system.hpp"
+#include "lve_pipeline_library.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -15,55 +16,82 @@
 
 namespace lve {
 	SimpleRenderSystem::SimpleRenderSystem(
-		LveDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
-		const std::string &vertShaderPath, const std::string &fragShaderPath, PipelineType type)
+		LveDevice &device, VkRenderPass renderPass, const LveDescriptorSetLayout &globalSetLayout,
+		const std::string &vertShaderPath, const std::string &fragShaderPath, PipelineType type,
+		LvePipelineBuildQueue *buildQueue, std::vector<std::string> features,
+		std::vector<SpecializationConstant> constants)
 		: lveDevice{device}
 	{
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass, vertShaderPath, fragShaderPath, type);
+		createPipeline(renderPass, vertShaderPath, fragShaderPath, type, buildQueue, std::move(features),
+						std::move(constants));
 	}
 
 	SimpleRenderSystem::~SimpleRenderSystem()
 	{
-		vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+		// builds of this system don't outlive it
+		if (pendingPipeline.valid()) pendingPipeline.wait();
+		for (auto &pending: pendingVariants)
+			if (pending.valid()) pending.wait();
 	}
 
-	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	void SimpleRenderSystem::createPipelineLayout(const LveDescriptorSetLayout &globalSetLayout)
 	{
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-		if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
-			VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
+		// every system with the same sets gets the same layout, so they can share pipelines
+		pipelineLayout = lveDevice.pipelineLibrary().getPipelineLayout({&globalSetLayout});
 	}
 
 	void SimpleRenderSystem::createPipeline(VkRenderPass renderPass, const std::string &vertShaderPath,
-											const std::string &fragShaderPath, PipelineType type)
+											const std::string &fragShaderPath, PipelineType type,
+											LvePipelineBuildQueue *buildQueue, std::vector<std::string> features,
+											std::vector<SpecializationConstant> constants)
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-		PipelineConfigInfo pipelineConfig{};
+		auto configure = [type, renderPass, layout = pipelineLayout](PipelineConfigInfo &pipelineConfig) {
+			if (type == PipelineType::default_pipeline)
+				LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
+			else if (type == PipelineType::transparent_pipeline)
+				LvePipeline::transparentPipelineConfigInfo(pipelineConfig);
+			else
+				LvePipeline::shadowPipelineConfigInfo(pipelineConfig);
 
-		if (type == PipelineType::default_pipeline)
-			LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
-		else
-			LvePipeline::shadowPipelineConfigInfo(pipelineConfig);
+			pipelineConfig.renderPass = renderPass;
+			pipelineConfig.pipelineLayout = layout;
+		};
 
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = pipelineLayout;
-		lvePipeline = std::make_unique<LvePipeline>(
-			lveDevice,
-			vertShaderPath,
-			fragShaderPath,
-			pipelineConfig);
+		permutations = std::make_unique<LvePipelinePermutations>(
+			lveDevice, PipelineBuildDesc{vertShaderPath, fragShaderPath, configure}, std::move(features));
+		permutations->setConstants(std::move(constants));
+
+		if (buildQueue)
+		{
+			pendingPipeline = buildQueue->submit(permutations->describe(0));
+			return;
+		}
+
+		lvePipeline = &permutations->get(0);
+	}
+
+	void SimpleRenderSystem::prepareVariants(const std::vector<uint32_t> &variants, LvePipelineBuildQueue *buildQueue)
+	{
+		for (uint32_t variant: variants)
+		{
+			if (variant == 0) continue;
+			if (buildQueue)
+				pendingVariants.push_back(buildQueue->submit(permutations->describe(variant)));
+			else
+				permutations->get(variant);
+		}
+	}
+
+	void SimpleRenderSystem::collectPipeline()
+	{
+		if (pendingPipeline.valid()) lvePipeline = pendingPipeline.get();
+		// the pipelines are in the library now, the permutations find them there on first use
+		for (auto &pending: pendingVariants)
+			pending.get();
+		pendingVariants.clear();
 	}
 
 	void SimpleRenderSystem::createShadowPipeline(VkRenderPass renderPass, const std::string &vertShaderPath,
@@ -75,10 +103,6 @@ namespace lve {
 		LvePipeline::shadowPipelineConfigInfo(pipelineConfig);
 		pipelineConfig.renderPass = renderPass;
 		pipelineConfig.pipelineLayout = pipelineLayout;
-		lvePipeline = std::make_unique<LvePipeline>(
-			lveDevice,
-			vertShaderPath,
-			fragShaderPath,
-			pipelineConfig);
+		lvePipeline = &lveDevice.pipelineLibrary().get(vertShaderPath, fragShaderPath, pipelineConfig);
 	}
 } // namespace lve
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "lve_descriptors.hpp"
 #include "lve_device.hpp"
 #include "lve_frame_info.hpp"
 #include "lve_pipeline.hpp"
+#include "lve_pipeline_build_queue.hpp"
+#include "lve_pipeline_permutations.hpp"
 
 // std
 #include <memory>
@@ -13,12 +16,15 @@ namespace lve {
 	public:
 		enum PipelineType {
 			default_pipeline,
-			shadow_pipeline
+			shadow_pipeline,
+			transparent_pipeline
 		};
 
 		SimpleRenderSystem(
-			LveDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
-			const std::string &vertShaderPath, const std::string &fragShaderPath, PipelineType type);
+			LveDevice &device, VkRenderPass renderPass, const LveDescriptorSetLayout &globalSetLayout,
+			const std::string &vertShaderPath, const std::string &fragShaderPath, PipelineType type,
+			LvePipelineBuildQueue *buildQueue = nullptr, std::vector<std::string> features = {},
+			std::vector<SpecializationConstant> constants = {});
 
 		~SimpleRenderSystem();
 
@@ -26,22 +32,36 @@ namespace lve {
 
 		SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
 
-		VkPipeline getPipeline() const { return lvePipeline->getPipeline(); };
+		// submits the variants to the build queue, or builds them right away without one
+		void prepareVariants(const std::vector<uint32_t> &variants, LvePipelineBuildQueue *buildQueue = nullptr);
+
+		// takes the pipelines submitted to the build queue, call it once the queue's wait returned
+		void collectPipeline();
+
+		// variant 0 is built with the system, any other is built the first time it is asked for
+		VkPipeline getPipeline(uint32_t variant = 0)
+		{
+			return variant == 0 ? lvePipeline->getPipeline() : permutations->getPipeline(variant);
+		}
 
 		VkPipelineLayout getPipelineLayout() const { return pipelineLayout; };
 
 	private:
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+		void createPipelineLayout(const LveDescriptorSetLayout &globalSetLayout);
 
 		void createPipeline(VkRenderPass renderPass, const std::string &vertShaderPath,
-							const std::string &fragShaderPath, PipelineType type);
+							const std::string &fragShaderPath, PipelineType type, LvePipelineBuildQueue *buildQueue,
+							std::vector<std::string> features, std::vector<SpecializationConstant> constants);
 
 		void createShadowPipeline(VkRenderPass renderPass, const std::string &vertShaderPath,
 						const std::string &fragShaderPath);
 
 		LveDevice &lveDevice;
 
-		std::unique_ptr<LvePipeline> lvePipeline;
-		VkPipelineLayout pipelineLayout;
+		LvePipeline *lvePipeline = nullptr; // owned by the device's pipeline library
+		std::future<LvePipeline *> pendingPipeline;
+		std::unique_ptr<LvePipelinePermutations> permutations;
+		std::vector<std::future<LvePipeline *> > pendingVariants;
+		VkPipelineLayout pipelineLayout; // owned by the device's pipeline library
 	};
 } // namespace lve